@@ -0,0 +1,69 @@
+#ifndef APP_CONTEXT_H
+#define APP_CONTEXT_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stddef.h>
+
+#include "cache_line.h"
+#include "command.h"
+#include "export.h"
+#include "hash_table.h"
+#include "logger.h"
+#include "shm_table.h"
+
+// One independent slice of the key space. A record lives in shard
+// `hash % shard_count`, so single-key commands only take that shard's lock.
+// Shards start on their own cache line, and the lock, which every reader
+// writes, does not share one with the table.
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) hash_table_t table;
+    _Alignas(CACHE_LINE_SIZE) pthread_rwlock_t table_lock;
+} table_shard_t;
+
+// Read-mostly configuration comes first. Each field that threads write
+// concurrently starts its own cache line, so the lock counters, the
+// logger and the scheduler do not false-share.
+typedef struct {
+    // Separate allocations, so a pinned worker can put its shard on its own
+    // node (app_context_rehome_shard).
+    table_shard_t **shards;
+    size_t shard_count;
+    shm_table_t *shm;
+    // The final PRINT of a batch run is also exported here when set.
+    const char *export_path;
+    export_format_t export_format;
+    int export_threads;  // <= 0: one per online CPU
+    _Alignas(CACHE_LINE_SIZE) logger_t logger;
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t read_lock_acq;
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t read_lock_rel;
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t write_lock_acq;
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t write_lock_rel;
+    // The priority turn is only touched under sched_mutex.
+    _Alignas(CACHE_LINE_SIZE) pthread_mutex_t sched_mutex;
+    pthread_cond_t sched_cond;
+    int next_priority;
+} app_context_t;
+
+// Opens the log at `log_path`. Returns 0 on success.
+int app_context_init(app_context_t *app, const char *log_path,
+                     size_t shard_count);
+void app_context_destroy(app_context_t *app);
+// Turns on the salary index of every shard. Returns false on allocation
+// failure.
+bool app_context_enable_salary_index(app_context_t *app);
+table_shard_t *app_shard_for(app_context_t *app, uint32_t hash);
+// Replaces the still-empty shard `index` with one allocated and initialised
+// by the calling thread, so first-touch puts its header, lock and records on
+// that thread's node. Nothing else may use the shard meanwhile. Returns 0 on
+// success; on failure the old shard stays in place.
+int app_context_rehome_shard(app_context_t *app, size_t index);
+
+// Runs one command against the table, writing its feedback to `out`.
+void execute_command(app_context_t *app, const command_t *cmd, FILE *out,
+                     bool final_run);
+void log_final_summary(app_context_t *app);
+
+#endif
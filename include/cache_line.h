@@ -0,0 +1,8 @@
+#ifndef CACHE_LINE_H
+#define CACHE_LINE_H
+
+// Coherence unit on the x86-64 and AArch64 machines chash runs on. Data
+// written by different threads is kept on separate lines of this size.
+#define CACHE_LINE_SIZE 64
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef COMMAND_H
+#define COMMAND_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hash_table.h"
+
+#define MAX_LINE_LEN 256
+
+typedef enum {
+    CMD_INSERT,
+    CMD_DELETE,
+    CMD_UPDATE,
+    CMD_SEARCH,
+    CMD_PRINT,
+    CMD_RANGE,
+    CMD_STATS
+} command_type_t;
+
+typedef struct {
+    command_type_t type;
+    char name[MAX_NAME_LEN];
+    uint32_t value;
+    uint32_t upper;  // CMD_RANGE: inclusive upper salary bound
+    int priority;
+} command_t;
+
+char *trim(char *str);
+bool parse_uint32(const char *token, uint32_t *value);
+bool parse_int(const char *token, int *value);
+// Parses one `cmd,name,value,priority` line. Returns 0 on success.
+int parse_command_line(char *line, command_t *command);
+// Upper-case command name as used in hash.log, e.g. "INSERT".
+const char *command_name(command_type_t type);
+
+#endif
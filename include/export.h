@@ -0,0 +1,38 @@
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "hash_table.h"
+
+// Bulk dump of a table snapshot. Records are formatted in chunks by a pool
+// of threads into large buffers, and the calling thread writes the buffers
+// in record order.
+
+typedef enum {
+    EXPORT_TEXT,    // hash,name,salary lines, as PRINT shows them
+    EXPORT_CSV,     // header line, names quoted when needed
+    EXPORT_BINARY   // see below
+} export_format_t;
+
+// Binary layout, all integers little-endian:
+//   "CHASHDB1", uint64 record count, then per record
+//   uint32 hash, uint32 salary, char name[MAX_NAME_LEN] (NUL padded).
+#define EXPORT_BINARY_MAGIC "CHASHDB1"
+
+// Accepts "text", "csv" or "bin".
+bool export_parse_format(const char *text, export_format_t *format);
+
+// Writes `records` to `out`. `threads` <= 0 uses every online CPU; small
+// dumps are formatted on the calling thread. Returns 0 on success, -1 on an
+// allocation or write error.
+int export_records(FILE *out, const record_snapshot_t *records, size_t count,
+                   export_format_t format, int threads);
+
+// export_records into a newly created file at `path`. Returns 0 on success.
+int export_to_file(const char *path, const record_snapshot_t *records,
+                   size_t count, export_format_t format, int threads);
+
+#endif
@@ -0,0 +1,270 @@
+#ifndef GENERIC_TABLE_H
+#define GENERIC_TABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cache_line.h"
+
+// Sorted table whose key and value types are fixed at compile time. Entries
+// are kept in (hash, key) order, so walking the table gives a deterministic
+// order and a miss stops at the first larger hash. Callers provide the
+// locking.
+//
+// The table is an unrolled list of cache-line-aligned blocks. The first
+// line of a block holds the link and the hashes of up to
+// GENERIC_TABLE_BLOCK_ENTRIES entries, so a lookup scans contiguous hashes
+// and skips whole blocks without touching keys or values. Those live in
+// the cold part of the block and are only read on a hash match.
+//
+//   GENERIC_TABLE_DECLARE(name, key_type, value_type)
+//       declares name##_t, name##_entry_t and friends; place it in a header.
+//   GENERIC_TABLE_DEFINE(name, key_type, value_type, hash_fn, compare_fn)
+//       defines the operations as static inline functions in the including
+//       translation unit.
+//
+//   uint32_t hash_fn(const key_type *key);
+//   int compare_fn(const key_type *a, const key_type *b);  // <0, 0, >0
+//
+// hash_fn and compare_fn are called directly, so they can be macros or
+// static inline functions and are inlined into every operation. Keys and
+// values are copied by assignment. Entry pointers returned by the table
+// stay valid until the next insert or remove.
+//
+// Example, a table of part counts keyed by a fixed-size SKU (built with a
+// collision-heavy hash by `make check`, src/generic_table_check.c):
+//
+//   typedef struct { char code[16]; } sku_t;
+//   GENERIC_TABLE_DECLARE(stock_table, sku_t, uint32_t)
+//   static inline uint32_t sku_hash(const sku_t *s) { ... }
+//   static inline int sku_compare(const sku_t *a, const sku_t *b) {
+//       return strncmp(a->code, b->code, sizeof(a->code));
+//   }
+//   GENERIC_TABLE_DEFINE(stock_table, sku_t, uint32_t, sku_hash, sku_compare)
+
+// Link, count and hashes fill exactly one line on 64-bit targets.
+#define GENERIC_TABLE_BLOCK_ENTRIES                                            \
+    ((CACHE_LINE_SIZE - sizeof(void *) - sizeof(uint32_t)) / sizeof(uint32_t))
+
+typedef enum {
+    GENERIC_TABLE_OK = 0,
+    GENERIC_TABLE_DUPLICATE,
+    GENERIC_TABLE_NOT_FOUND,
+    GENERIC_TABLE_NO_MEMORY
+} generic_table_status_t;
+
+#define GENERIC_TABLE_DECLARE(name, key_type, value_type)                      \
+    typedef struct {                                                           \
+        key_type key;                                                          \
+        value_type value;                                                      \
+    } name##_entry_t;                                                          \
+                                                                               \
+    typedef struct name##_block {                                              \
+        /* Hot: everything a lookup reads before it finds the hash. */         \
+        _Alignas(CACHE_LINE_SIZE) struct name##_block *next;                   \
+        uint32_t count;  /* never 0 while linked */                            \
+        uint32_t hashes[GENERIC_TABLE_BLOCK_ENTRIES];                          \
+        /* Cold: read on a hash match only. */                                 \
+        _Alignas(CACHE_LINE_SIZE)                                              \
+            name##_entry_t entries[GENERIC_TABLE_BLOCK_ENTRIES];               \
+    } name##_block_t;                                                          \
+                                                                               \
+    typedef struct {                                                           \
+        name##_block_t *head;                                                  \
+        size_t count;                                                          \
+    } name##_t;                                                                \
+                                                                               \
+    /* In-order cursor; see name##_first and name##_next. */                   \
+    typedef struct {                                                           \
+        name##_block_t *block;                                                 \
+        uint32_t index;                                                        \
+    } name##_iter_t;
+
+#define GENERIC_TABLE_DEFINE(name, key_type, value_type, hash_fn, compare_fn)  \
+    /* Where (hash, key) is or would be inserted. `prev` precedes `block`. */  \
+    typedef struct {                                                           \
+        name##_block_t *prev;                                                  \
+        name##_block_t *block;                                                 \
+        uint32_t index;                                                        \
+    } name##_pos_t;                                                            \
+                                                                               \
+    static inline name##_pos_t name##_locate(const name##_t *table,            \
+                                             uint32_t hash,                    \
+                                             const key_type *key) {            \
+        name##_pos_t pos = {NULL, table->head, 0};                             \
+        if (!pos.block) {                                                      \
+            return pos;                                                        \
+        }                                                                      \
+        /* Skip blocks by their last hash; only hot lines are read. */         \
+        while (pos.block->next &&                                              \
+               pos.block->hashes[pos.block->count - 1] < hash) {               \
+            pos.prev = pos.block;                                              \
+            pos.block = pos.block->next;                                       \
+        }                                                                      \
+        while (pos.index < pos.block->count &&                                 \
+               pos.block->hashes[pos.index] < hash) {                          \
+            pos.index++;                                                       \
+        }                                                                      \
+        /* Equal hashes are ordered by key and may span blocks. */             \
+        for (;;) {                                                             \
+            while (pos.index < pos.block->count &&                             \
+                   pos.block->hashes[pos.index] == hash &&                     \
+                   compare_fn(&pos.block->entries[pos.index].key, key) < 0) {  \
+                pos.index++;                                                   \
+            }                                                                  \
+            if (pos.index < pos.block->count || !pos.block->next ||            \
+                pos.block->next->hashes[0] != hash) {                          \
+                return pos;                                                    \
+            }                                                                  \
+            pos.prev = pos.block;                                              \
+            pos.block = pos.block->next;                                       \
+            pos.index = 0;                                                     \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    static inline bool name##_matches(const name##_pos_t *pos, uint32_t hash,  \
+                                      const key_type *key) {                   \
+        return pos->block && pos->index < pos->block->count &&                 \
+               pos->block->hashes[pos->index] == hash &&                       \
+               compare_fn(&pos->block->entries[pos->index].key, key) == 0;     \
+    }                                                                          \
+                                                                               \
+    static inline name##_block_t *name##_new_block(void) {                     \
+        name##_block_t *block = (name##_block_t *)aligned_alloc(               \
+            CACHE_LINE_SIZE, sizeof(name##_block_t));                          \
+        if (block) {                                                           \
+            block->next = NULL;                                                \
+            block->count = 0;                                                  \
+        }                                                                      \
+        return block;                                                          \
+    }                                                                          \
+                                                                               \
+    static inline void name##_init(name##_t *table) {                          \
+        table->head = NULL;                                                    \
+        table->count = 0;                                                      \
+    }                                                                          \
+                                                                               \
+    static inline void name##_destroy(name##_t *table) {                       \
+        name##_block_t *block = table->head;                                   \
+        while (block) {                                                        \
+            name##_block_t *next = block->next;                                \
+            free(block);                                                       \
+            block = next;                                                      \
+        }                                                                      \
+        table->head = NULL;                                                    \
+        table->count = 0;                                                      \
+    }                                                                          \
+                                                                               \
+    /* On success *entry_out (if non-NULL) points at the new entry. */         \
+    static inline generic_table_status_t name##_insert(                        \
+        name##_t *table, const key_type *key, const value_type *value,         \
+        name##_entry_t **entry_out) {                                          \
+        uint32_t hash = hash_fn(key);                                          \
+        name##_pos_t pos = name##_locate(table, hash, key);                    \
+        if (name##_matches(&pos, hash, key)) {                                 \
+            return GENERIC_TABLE_DUPLICATE;                                    \
+        }                                                                      \
+                                                                               \
+        name##_block_t *block = pos.block;                                     \
+        uint32_t index = pos.index;                                            \
+        if (!block) {                                                          \
+            block = name##_new_block();                                        \
+            if (!block) {                                                      \
+                return GENERIC_TABLE_NO_MEMORY;                                \
+            }                                                                  \
+            table->head = block;                                               \
+        } else if (block->count == GENERIC_TABLE_BLOCK_ENTRIES) {              \
+            /* Split a full block in half and insert into the right one. */    \
+            name##_block_t *upper = name##_new_block();                        \
+            if (!upper) {                                                      \
+                return GENERIC_TABLE_NO_MEMORY;                                \
+            }                                                                  \
+            uint32_t keep = (uint32_t)GENERIC_TABLE_BLOCK_ENTRIES / 2;         \
+            upper->count = block->count - keep;                                \
+            memcpy(upper->hashes, block->hashes + keep,                        \
+                   upper->count * sizeof(uint32_t));                           \
+            memcpy(upper->entries, block->entries + keep,                      \
+                   upper->count * sizeof(name##_entry_t));                     \
+            block->count = keep;                                               \
+            upper->next = block->next;                                         \
+            block->next = upper;                                               \
+            if (index > keep) {                                                \
+                block = upper;                                                 \
+                index -= keep;                                                 \
+            }                                                                  \
+        }                                                                      \
+                                                                               \
+        memmove(block->hashes + index + 1, block->hashes + index,              \
+                (block->count - index) * sizeof(uint32_t));                    \
+        memmove(block->entries + index + 1, block->entries + index,            \
+                (block->count - index) * sizeof(name##_entry_t));              \
+        block->hashes[index] = hash;                                           \
+        block->entries[index].key = *key;                                      \
+        block->entries[index].value = *value;                                  \
+        block->count++;                                                        \
+        table->count++;                                                        \
+        if (entry_out) {                                                       \
+            *entry_out = &block->entries[index];                               \
+        }                                                                      \
+        return GENERIC_TABLE_OK;                                               \
+    }                                                                          \
+                                                                               \
+    static inline name##_entry_t *name##_find(const name##_t *table,           \
+                                              const key_type *key) {           \
+        uint32_t hash = hash_fn(key);                                          \
+        name##_pos_t pos = name##_locate(table, hash, key);                    \
+        return name##_matches(&pos, hash, key)                                 \
+                   ? &pos.block->entries[pos.index]                            \
+                   : NULL;                                                     \
+    }                                                                          \
+                                                                               \
+    /* Copies the value out to *removed (if non-NULL) before dropping it. */   \
+    static inline generic_table_status_t name##_remove(                        \
+        name##_t *table, const key_type *key, value_type *removed) {           \
+        uint32_t hash = hash_fn(key);                                          \
+        name##_pos_t pos = name##_locate(table, hash, key);                    \
+        if (!name##_matches(&pos, hash, key)) {                                \
+            return GENERIC_TABLE_NOT_FOUND;                                    \
+        }                                                                      \
+                                                                               \
+        name##_block_t *block = pos.block;                                     \
+        if (removed) {                                                         \
+            *removed = block->entries[pos.index].value;                        \
+        }                                                                      \
+        block->count--;                                                        \
+        table->count--;                                                        \
+        if (block->count == 0) {                                               \
+            if (pos.prev) {                                                    \
+                pos.prev->next = block->next;                                  \
+            } else {                                                           \
+                table->head = block->next;                                     \
+            }                                                                  \
+            free(block);                                                       \
+            return GENERIC_TABLE_OK;                                           \
+        }                                                                      \
+        memmove(block->hashes + pos.index, block->hashes + pos.index + 1,      \
+                (block->count - pos.index) * sizeof(uint32_t));                \
+        memmove(block->entries + pos.index, block->entries + pos.index + 1,    \
+                (block->count - pos.index) * sizeof(name##_entry_t));          \
+        return GENERIC_TABLE_OK;                                               \
+    }                                                                          \
+                                                                               \
+    static inline name##_entry_t *name##_first(const name##_t *table,          \
+                                               name##_iter_t *iter) {          \
+        iter->block = table->head;                                             \
+        iter->index = 0;                                                       \
+        return iter->block ? &iter->block->entries[0] : NULL;                  \
+    }                                                                          \
+                                                                               \
+    static inline name##_entry_t *name##_next(name##_iter_t *iter) {           \
+        if (++iter->index == iter->block->count) {                             \
+            iter->block = iter->block->next;                                   \
+            iter->index = 0;                                                   \
+        }                                                                      \
+        return iter->block ? &iter->block->entries[iter->index] : NULL;        \
+    }
+
+#endif
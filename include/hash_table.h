@@ -7,27 +7,85 @@
 
 #define MAX_NAME_LEN 50
 
-typedef struct hash_record {
-    uint32_t hash;
+struct salary_index;
+
+#ifdef CHASH_ENGINE_SKIPLIST
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "cache_line.h"
+
+// Lock-free skiplist ordered by hash (src/hash_table_skiplist.c). Lookups,
+// snapshots and, without the salary index, all mutations are safe to call
+// concurrently without external locking.
+#define HASH_TABLE_CONCURRENT 1
+
+struct skiplist_node;
+
+typedef struct {
+    struct skiplist_node *head;
+    // Written by every insert and delete.
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t count;
+    _Atomic uint64_t salary_sum;
+    // Optional ordered index on salary; NULL until enabled. While it is on,
+    // writers and salary queries serialize on index_mutex.
+    struct salary_index *salary_index;
+    pthread_mutex_t index_mutex;
+    // Unlinked nodes wait here until no operation can still reach them.
+    // Every operation, readers included, writes `active`.
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t active[2];
+    _Atomic unsigned reclaim_epoch;
+    struct skiplist_node *_Atomic retired;
+    atomic_size_t retired_count;
+    pthread_mutex_t reclaim_mutex;
+} hash_table_t;
+
+#else
+
+#include "generic_table.h"
+
+// Sorted list of cache-line blocks (src/hash_table.c, generic_table.h).
+// Callers provide the locking.
+#define HASH_TABLE_CONCURRENT 0
+
+typedef struct {
     char name[MAX_NAME_LEN];
     uint32_t salary;
-    struct hash_record *next;
-} hash_record_t;
+} employee_t;
+
+// Employees are keyed by the Jenkins hash of their name, so the list order
+// is hash order.
+GENERIC_TABLE_DECLARE(employee_table, uint32_t, employee_t)
 
 typedef struct {
-    hash_record_t *head;
+    employee_table_t records;
+    uint64_t salary_sum;
+    // Optional ordered index on salary; NULL until enabled.
+    struct salary_index *salary_index;
 } hash_table_t;
 
+#endif
+
 typedef struct {
     uint32_t hash;
     char name[MAX_NAME_LEN];
     uint32_t salary;
 } record_snapshot_t;
 
+typedef struct {
+    size_t count;
+    uint64_t salary_sum;
+    // Only meaningful when count > 0.
+    uint32_t salary_min;
+    uint32_t salary_max;
+} table_stats_t;
+
 typedef enum {
     TABLE_OK = 0,
     TABLE_DUPLICATE,
-    TABLE_NOT_FOUND
+    TABLE_NOT_FOUND,
+    TABLE_FULL  // bounded stores (shm_table) only
 } table_status_t;
 
 void hash_table_init(hash_table_t *table);
@@ -45,4 +103,14 @@ bool hash_table_find(const hash_table_t *table, uint32_t hash,
 size_t hash_table_snapshot(const hash_table_t *table,
                            record_snapshot_t **records_out);
 
+// Builds the salary index from the current records and keeps it up to date
+// from then on. Returns false if it could not be allocated.
+bool hash_table_enable_salary_index(hash_table_t *table);
+// O(1) with the salary index; min/max need a full scan without it.
+void hash_table_stats(const hash_table_t *table, table_stats_t *stats);
+// Copies records with low <= salary <= high, ordered by salary then hash.
+// Returns the number of copied records. If allocation fails, returns SIZE_MAX.
+size_t hash_table_salary_range(const hash_table_t *table, uint32_t low,
+                               uint32_t high, record_snapshot_t **records_out);
+
 #endif
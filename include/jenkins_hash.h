@@ -0,0 +1,9 @@
+#ifndef JENKINS_HASH_H
+#define JENKINS_HASH_H
+
+#include <stdint.h>
+
+// Jenkins one-at-a-time hash used as the record key for every table.
+uint32_t jenkins_hash(const char *key);
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef NODE_TOPOLOGY_H
+#define NODE_TOPOLOGY_H
+
+#include <stddef.h>
+
+// Online NUMA nodes as reported by sysfs. Hosts without NUMA information
+// look like a single node 0.
+typedef struct {
+    int *nodes;
+    size_t count;
+} node_topology_t;
+
+int node_topology_load(node_topology_t *topology);
+void node_topology_free(node_topology_t *topology);
+
+// Restricts the calling thread to the CPUs of `node`. Memory the thread
+// touches first afterwards is then placed on that node by the kernel's
+// default local allocation policy. Returns 0 on success.
+int node_topology_pin(int node);
+
+#endif
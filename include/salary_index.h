@@ -0,0 +1,34 @@
+#ifndef SALARY_INDEX_H
+#define SALARY_INDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hash_table.h"
+
+// Skiplist of record copies ordered by (salary, hash). The owning table keeps
+// it in sync and provides the locking.
+typedef struct salary_index salary_index_t;
+
+// The index order for two record_snapshot_t, as a qsort comparator. Tables
+// without an index sort by it so RANGE output does not depend on the index.
+int salary_index_compare(const void *a, const void *b);
+
+salary_index_t *salary_index_create(void);
+void salary_index_destroy(salary_index_t *index);
+// Returns false if the entry could not be allocated.
+bool salary_index_add(salary_index_t *index, const record_snapshot_t *record);
+void salary_index_remove(salary_index_t *index, uint32_t hash,
+                         uint32_t salary);
+// Re-keys an existing entry without allocating.
+void salary_index_move(salary_index_t *index, uint32_t hash,
+                       uint32_t old_salary, uint32_t new_salary);
+bool salary_index_min(const salary_index_t *index, record_snapshot_t *result);
+bool salary_index_max(const salary_index_t *index, record_snapshot_t *result);
+// Copies entries with low <= salary <= high in index order. Returns the
+// number of copied records. If allocation fails, returns SIZE_MAX.
+size_t salary_index_range(const salary_index_t *index, uint32_t low,
+                          uint32_t high, record_snapshot_t **records_out);
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "app_context.h"
+
+#define SERVER_DEFAULT_WORKERS 4
+
+typedef struct {
+    const char *unix_path;  // listen on this Unix socket when set
+    int tcp_port;           // otherwise listen on 127.0.0.1:tcp_port
+    int workers;
+} server_config_t;
+
+// Serves commands.txt-style lines until SIGINT or SIGTERM. Each response is
+// the text chash prints for the command, followed by an empty line. Clients
+// may pipeline; responses come back in request order. Returns 0 on a clean
+// shutdown.
+int server_run(app_context_t *app, const server_config_t *config);
+
+#endif
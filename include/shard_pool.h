@@ -0,0 +1,20 @@
+#ifndef SHARD_POOL_H
+#define SHARD_POOL_H
+
+#include <stddef.h>
+
+#include "app_context.h"
+#include "command.h"
+
+#define SHARD_QUEUE_CAPACITY 1024
+
+// Runs `commands` in priority order with one worker per shard. Workers are
+// pinned to NUMA nodes round-robin and rebuild their (still empty) shard
+// before running any command, so its header, lock and records are all
+// allocated on the worker's node. Commands for different shards run in parallel;
+// PRINT, RANGE and STATS wait for every shard to drain and then gather
+// across them.
+// Returns 0 on success.
+int shard_pool_run(app_context_t *app, command_t *commands, size_t count);
+
+#endif
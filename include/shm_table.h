@@ -0,0 +1,56 @@
+#ifndef SHM_TABLE_H
+#define SHM_TABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hash_table.h"
+
+#define SHM_TABLE_DEFAULT_CAPACITY 65536
+
+// A copy of the table published in a POSIX shared-memory segment. The
+// segment is split into regions, one per chash shard (`hash % regions`).
+// Each region is an open-addressing slot array guarded by its own seqlock,
+// so writers to different shards never share a lock or a cache line, and
+// readers only need a read-only mapping and never block the writer.
+typedef struct shm_table shm_table_t;
+
+// Reader results. SHM_READ_BUSY means the writer stayed in the middle of an
+// update for the whole retry window, which happens when chash dies there.
+typedef enum {
+    SHM_READ_OK = 0,
+    SHM_READ_NOT_FOUND,
+    SHM_READ_BUSY,
+    SHM_READ_NO_MEMORY
+} shm_read_status_t;
+
+// Writer side, used by chash. Any existing segment with the same name is
+// replaced. `capacity` records are split evenly over `regions` regions.
+// Writes to one region are serialized internally.
+shm_table_t *shm_table_create(const char *name, size_t capacity,
+                              size_t regions);
+// Returns TABLE_FULL, and stores nothing, when the record's region is full.
+table_status_t shm_table_insert(shm_table_t *shm, uint32_t hash,
+                                const char *name, uint32_t salary);
+table_status_t shm_table_update(shm_table_t *shm, uint32_t hash,
+                                uint32_t salary);
+table_status_t shm_table_delete(shm_table_t *shm, uint32_t hash);
+
+// Reader side. Attaching fails if the segment is missing or not a table.
+shm_table_t *shm_table_attach(const char *name);
+shm_read_status_t shm_table_find(const shm_table_t *shm, uint32_t hash,
+                                 record_snapshot_t *result);
+// Copies every record, sorted by hash, into a new array stored in
+// `records_out` (NULL when there are none) and their number in `count_out`.
+// Each region is copied consistently; regions are not frozen together.
+shm_read_status_t shm_table_snapshot(const shm_table_t *shm,
+                                     record_snapshot_t **records_out,
+                                     size_t *count_out);
+size_t shm_table_capacity(const shm_table_t *shm);
+
+// Unmaps the segment. The segment itself stays until shm_table_unlink.
+void shm_table_close(shm_table_t *shm);
+int shm_table_unlink(const char *name);
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Optional Chrome Trace Event / Perfetto timeline. Every thread appends
+// complete spans to its own buffer without locking; the buffers are only
+// merged into JSON by trace_close, after the worker threads are done.
+
+typedef enum {
+    TRACE_SCHED_WAIT,
+    TRACE_LOCK_WAIT,
+    TRACE_LOCK_HOLD,
+    TRACE_COMMAND
+} trace_kind_t;
+
+// Starts recording. Returns 0 on success; tracing stays off on failure.
+int trace_open(const char *path);
+// Writes the JSON file and releases every buffer. Call once all traced
+// threads have stopped.
+void trace_close(void);
+
+// Returns the current time, or 0 while tracing is off.
+uint64_t trace_now(void);
+// Records a span from `start` (a trace_now value) until now. `detail` must
+// be a string literal or otherwise outlive the trace.
+void trace_span(trace_kind_t kind, uint64_t start, const char *detail);
+// Lock holds nest (PRINT holds every shard lock); acquisitions and releases
+// are matched in LIFO order.
+void trace_lock_acquired(void);
+void trace_lock_released(const char *detail);
+// Labels the calling thread's track.
+void trace_thread_name(const char *fmt, ...);
+
+#endif
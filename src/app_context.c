@@ -0,0 +1,627 @@
+#include "app_context.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "export.h"
+#include "jenkins_hash.h"
+#include "salary_index.h"
+#include "trace.h"
+
+static void perform_insert(app_context_t *app, const command_t *cmd,
+                           FILE *out);
+static void perform_delete(app_context_t *app, const command_t *cmd,
+                           FILE *out);
+static void perform_update(app_context_t *app, const command_t *cmd,
+                           FILE *out);
+static void perform_search(app_context_t *app, const command_t *cmd,
+                           FILE *out);
+static void perform_print(app_context_t *app, const command_t *cmd, FILE *out,
+                          bool final_run);
+static void perform_range(app_context_t *app, const command_t *cmd,
+                          FILE *out);
+static void perform_stats(app_context_t *app, const command_t *cmd,
+                          FILE *out);
+
+typedef size_t (*shard_collect_fn)(const hash_table_t *table, const void *arg,
+                                   record_snapshot_t **records_out);
+typedef bool (*record_compare_fn)(const record_snapshot_t *a,
+                                  const record_snapshot_t *b);
+
+// How a multi-shard read protects itself from writers. Untracked locks skip
+// the lock counters and log entries; unlocked reads need an engine that
+// supports concurrent traversal (HASH_TABLE_CONCURRENT).
+typedef enum {
+    SHARDS_TRACKED,
+    SHARDS_UNTRACKED,
+    SHARDS_UNLOCKED
+} shard_lock_mode_t;
+
+// Snapshots and searches skip the shard locks when the engine allows it.
+#define READ_LOCK_MODE \
+    (HASH_TABLE_CONCURRENT ? SHARDS_UNLOCKED : SHARDS_TRACKED)
+
+static void lock_all_shards(app_context_t *app, int priority,
+                            shard_lock_mode_t mode);
+static void unlock_all_shards(app_context_t *app, int priority,
+                              shard_lock_mode_t mode);
+static size_t gather_shards(app_context_t *app, int priority,
+                            shard_lock_mode_t mode,
+                            shard_collect_fn collect, const void *arg,
+                            record_compare_fn compare,
+                            record_snapshot_t **records_out);
+static size_t collect_snapshot(const hash_table_t *table, const void *arg,
+                               record_snapshot_t **records_out);
+static size_t collect_range(const hash_table_t *table, const void *arg,
+                            record_snapshot_t **records_out);
+static bool hash_before(const record_snapshot_t *a,
+                        const record_snapshot_t *b);
+static bool salary_before(const record_snapshot_t *a,
+                          const record_snapshot_t *b);
+static size_t merge_snapshots(record_snapshot_t **parts, const size_t *counts,
+                              size_t part_count, record_compare_fn before,
+                              record_snapshot_t **merged);
+static void acquire_read_lock(app_context_t *app, table_shard_t *shard,
+                              int priority);
+static void release_read_lock(app_context_t *app, table_shard_t *shard,
+                              int priority);
+static void acquire_write_lock(app_context_t *app, table_shard_t *shard,
+                               int priority);
+static void release_write_lock(app_context_t *app, table_shard_t *shard,
+                               int priority);
+
+static table_shard_t *shard_create(bool salary_index) {
+    // sizeof(table_shard_t) is a multiple of the line size by construction.
+    table_shard_t *shard =
+        (table_shard_t *)aligned_alloc(CACHE_LINE_SIZE, sizeof(table_shard_t));
+    if (!shard) {
+        return NULL;
+    }
+    hash_table_init(&shard->table);
+    pthread_rwlock_init(&shard->table_lock, NULL);
+    if (salary_index && !hash_table_enable_salary_index(&shard->table)) {
+        pthread_rwlock_destroy(&shard->table_lock);
+        hash_table_destroy(&shard->table);
+        free(shard);
+        return NULL;
+    }
+    return shard;
+}
+
+static void shard_destroy(table_shard_t *shard) {
+    if (!shard) {
+        return;
+    }
+    pthread_rwlock_destroy(&shard->table_lock);
+    hash_table_destroy(&shard->table);
+    free(shard);
+}
+
+static void destroy_shards(table_shard_t **shards, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        shard_destroy(shards[i]);
+    }
+    free(shards);
+}
+
+int app_context_init(app_context_t *app, const char *log_path,
+                     size_t shard_count) {
+    app->shards =
+        (table_shard_t **)calloc(shard_count, sizeof(table_shard_t *));
+    if (!app->shards) {
+        return -1;
+    }
+    app->shard_count = shard_count;
+    for (size_t i = 0; i < shard_count; ++i) {
+        app->shards[i] = shard_create(false);
+        if (!app->shards[i]) {
+            destroy_shards(app->shards, shard_count);
+            return -1;
+        }
+    }
+    pthread_mutex_init(&app->sched_mutex, NULL);
+    pthread_cond_init(&app->sched_cond, NULL);
+    atomic_init(&app->read_lock_acq, 0);
+    atomic_init(&app->read_lock_rel, 0);
+    atomic_init(&app->write_lock_acq, 0);
+    atomic_init(&app->write_lock_rel, 0);
+    app->next_priority = 0;
+    app->shm = NULL;
+    app->export_path = NULL;
+    app->export_format = EXPORT_CSV;
+    app->export_threads = 0;
+
+    if (logger_init(&app->logger, log_path) != 0) {
+        destroy_shards(app->shards, shard_count);
+        pthread_mutex_destroy(&app->sched_mutex);
+        pthread_cond_destroy(&app->sched_cond);
+        return -1;
+    }
+    return 0;
+}
+
+void app_context_destroy(app_context_t *app) {
+    shm_table_close(app->shm);
+    logger_close(&app->logger);
+    destroy_shards(app->shards, app->shard_count);
+    pthread_mutex_destroy(&app->sched_mutex);
+    pthread_cond_destroy(&app->sched_cond);
+}
+
+bool app_context_enable_salary_index(app_context_t *app) {
+    for (size_t i = 0; i < app->shard_count; ++i) {
+        table_shard_t *shard = app->shards[i];
+        pthread_rwlock_wrlock(&shard->table_lock);
+        bool ok = hash_table_enable_salary_index(&shard->table);
+        pthread_rwlock_unlock(&shard->table_lock);
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+table_shard_t *app_shard_for(app_context_t *app, uint32_t hash) {
+    return app->shards[hash % app->shard_count];
+}
+
+int app_context_rehome_shard(app_context_t *app, size_t index) {
+    table_shard_t *old = app->shards[index];
+    table_shard_t *shard = shard_create(old->table.salary_index != NULL);
+    if (!shard) {
+        return -1;
+    }
+    app->shards[index] = shard;
+    shard_destroy(old);
+    return 0;
+}
+
+void execute_command(app_context_t *app, const command_t *cmd, FILE *out,
+                     bool final_run) {
+    uint64_t start = trace_now();
+    switch (cmd->type) {
+        case CMD_INSERT:
+            perform_insert(app, cmd, out);
+            break;
+        case CMD_DELETE:
+            perform_delete(app, cmd, out);
+            break;
+        case CMD_UPDATE:
+            perform_update(app, cmd, out);
+            break;
+        case CMD_SEARCH:
+            perform_search(app, cmd, out);
+            break;
+        case CMD_PRINT:
+            perform_print(app, cmd, out, final_run);
+            break;
+        case CMD_RANGE:
+            perform_range(app, cmd, out);
+            break;
+        case CMD_STATS:
+            perform_stats(app, cmd, out);
+            break;
+    }
+    trace_span(TRACE_COMMAND, start, command_name(cmd->type));
+}
+
+static void perform_insert(app_context_t *app, const command_t *cmd,
+                           FILE *out) {
+    uint32_t hash = jenkins_hash(cmd->name);
+    logger_thread_log(&app->logger, cmd->priority, "INSERT,%u,%s,%u", hash,
+                      cmd->name, cmd->value);
+    table_shard_t *shard = app_shard_for(app, hash);
+    acquire_write_lock(app, shard, cmd->priority);
+    table_status_t status =
+        hash_table_insert(&shard->table, hash, cmd->name, cmd->value);
+    if (status == TABLE_OK && app->shm &&
+        shm_table_insert(app->shm, hash, cmd->name, cmd->value) != TABLE_OK) {
+        // Readers of the shared table must never miss a record chash has,
+        // so a record that does not fit there is not kept at all.
+        hash_table_delete(&shard->table, hash, NULL);
+        status = TABLE_FULL;
+    }
+    release_write_lock(app, shard, cmd->priority);
+
+    if (status == TABLE_OK) {
+        fprintf(out, "Inserted %u,%s,%u\n", hash, cmd->name, cmd->value);
+    } else if (status == TABLE_DUPLICATE) {
+        fprintf(out, "Insert failed. Entry %u is a duplicate.\n", hash);
+    } else if (status == TABLE_FULL) {
+        logger_thread_log(&app->logger, cmd->priority,
+                          "INSERT %u REJECTED, SHARED TABLE FULL", hash);
+        fprintf(out, "Insert failed. Shared table is full.\n");
+        fprintf(stderr, "Shared table is full; %s not inserted.\n",
+                cmd->name);
+    } else {
+        fprintf(stderr, "Insert failed for %s due to allocation error.\n",
+                cmd->name);
+    }
+}
+
+static void perform_delete(app_context_t *app, const command_t *cmd,
+                           FILE *out) {
+    uint32_t hash = jenkins_hash(cmd->name);
+    logger_thread_log(&app->logger, cmd->priority, "DELETE,%u,%s", hash,
+                      cmd->name);
+    table_shard_t *shard = app_shard_for(app, hash);
+    acquire_write_lock(app, shard, cmd->priority);
+    record_snapshot_t removed;
+    table_status_t status =
+        hash_table_delete(&shard->table, hash, &removed);
+    if (status == TABLE_OK && app->shm) {
+        shm_table_delete(app->shm, hash);
+    }
+    release_write_lock(app, shard, cmd->priority);
+
+    if (status == TABLE_OK) {
+        fprintf(out, "Deleted record for %u,%s,%u\n", removed.hash,
+                removed.name, removed.salary);
+    } else {
+        fprintf(out, "Entry %u not deleted. Not in database.\n", hash);
+    }
+}
+
+static void perform_update(app_context_t *app, const command_t *cmd,
+                           FILE *out) {
+    uint32_t hash = jenkins_hash(cmd->name);
+    logger_thread_log(&app->logger, cmd->priority, "UPDATE,%u,%s,%u", hash,
+                      cmd->name, cmd->value);
+    table_shard_t *shard = app_shard_for(app, hash);
+    acquire_write_lock(app, shard, cmd->priority);
+    record_snapshot_t before;
+    record_snapshot_t after;
+    table_status_t status =
+        hash_table_update(&shard->table, hash, cmd->value, &before, &after);
+    if (status == TABLE_OK && app->shm) {
+        shm_table_update(app->shm, hash, cmd->value);
+    }
+    release_write_lock(app, shard, cmd->priority);
+
+    if (status == TABLE_OK) {
+        fprintf(out, "Updated record %u from %u,%s,%u to %u,%s,%u\n", hash,
+                before.hash, before.name, before.salary, after.hash,
+                after.name, after.salary);
+    } else {
+        fprintf(out, "Update failed. Entry %u not found.\n", hash);
+    }
+}
+
+static void perform_search(app_context_t *app, const command_t *cmd,
+                           FILE *out) {
+    uint32_t hash = jenkins_hash(cmd->name);
+    logger_thread_log(&app->logger, cmd->priority, "SEARCH,%u,%s", hash,
+                      cmd->name);
+    table_shard_t *shard = app_shard_for(app, hash);
+    record_snapshot_t found;
+    bool exists;
+    if (READ_LOCK_MODE == SHARDS_UNLOCKED) {
+        exists = hash_table_find(&shard->table, hash, &found);
+    } else {
+        acquire_read_lock(app, shard, cmd->priority);
+        exists = hash_table_find(&shard->table, hash, &found);
+        release_read_lock(app, shard, cmd->priority);
+    }
+
+    if (exists) {
+        fprintf(out, "Found: %u,%s,%u\n", found.hash, found.name,
+                found.salary);
+    } else {
+        fprintf(out, "%s not found.\n", cmd->name);
+    }
+}
+
+static void perform_print(app_context_t *app, const command_t *cmd,
+                          FILE *out, bool final_run) {
+    logger_thread_log(&app->logger, cmd->priority, "PRINT");
+    record_snapshot_t *records = NULL;
+    size_t count = gather_shards(app, cmd->priority, READ_LOCK_MODE,
+                                 collect_snapshot, NULL, hash_before, &records);
+
+    if (count == SIZE_MAX) {
+        fprintf(stderr, "Unable to allocate memory for snapshot.\n");
+        return;
+    }
+
+    fprintf(out, "Current Database:\n");
+    if (export_records(out, records, count, EXPORT_TEXT,
+                       app->export_threads) != 0) {
+        fprintf(stderr, "Unable to write the database dump.\n");
+    }
+
+    if (final_run && app->export_path &&
+        export_to_file(app->export_path, records, count, app->export_format,
+                       app->export_threads) != 0) {
+        fprintf(stderr, "Unable to export the database to %s.\n",
+                app->export_path);
+    }
+
+    free(records);
+}
+
+static void perform_range(app_context_t *app, const command_t *cmd,
+                          FILE *out) {
+    logger_thread_log(&app->logger, cmd->priority, "RANGE,%u,%u", cmd->value,
+                      cmd->upper);
+    record_snapshot_t *records = NULL;
+    size_t count = gather_shards(app, cmd->priority, SHARDS_TRACKED,
+                                 collect_range, cmd, salary_before, &records);
+
+    if (count == SIZE_MAX) {
+        fprintf(stderr, "Unable to allocate memory for range query.\n");
+        return;
+    }
+
+    fprintf(out, "Salaries %u to %u:\n", cmd->value, cmd->upper);
+    for (size_t i = 0; i < count; ++i) {
+        fprintf(out, "%u,%s,%u\n", records[i].hash, records[i].name,
+                records[i].salary);
+    }
+
+    free(records);
+}
+
+static void perform_stats(app_context_t *app, const command_t *cmd,
+                          FILE *out) {
+    logger_thread_log(&app->logger, cmd->priority, "STATS");
+    table_stats_t total = {0, 0, 0, 0};
+    lock_all_shards(app, cmd->priority, SHARDS_TRACKED);
+    for (size_t i = 0; i < app->shard_count; ++i) {
+        table_stats_t part;
+        hash_table_stats(&app->shards[i]->table, &part);
+        if (part.count == 0) {
+            continue;
+        }
+        if (total.count == 0 || part.salary_min < total.salary_min) {
+            total.salary_min = part.salary_min;
+        }
+        if (total.count == 0 || part.salary_max > total.salary_max) {
+            total.salary_max = part.salary_max;
+        }
+        total.count += part.count;
+        total.salary_sum += part.salary_sum;
+    }
+    unlock_all_shards(app, cmd->priority, SHARDS_TRACKED);
+
+    if (total.count == 0) {
+        fprintf(out, "Payroll: 0 records, total 0\n");
+    } else {
+        fprintf(out, "Payroll: %zu records, total %llu, min %u, max %u\n",
+                total.count, (unsigned long long)total.salary_sum,
+                total.salary_min, total.salary_max);
+    }
+}
+
+// Read-locks every shard in index order, so writers (which hold a single
+// shard lock) cannot deadlock against it.
+static void lock_all_shards(app_context_t *app, int priority,
+                            shard_lock_mode_t mode) {
+    for (size_t i = 0; i < app->shard_count; ++i) {
+        if (mode == SHARDS_TRACKED) {
+            acquire_read_lock(app, app->shards[i], priority);
+        } else if (mode == SHARDS_UNTRACKED) {
+            pthread_rwlock_rdlock(&app->shards[i]->table_lock);
+        }
+    }
+}
+
+static void unlock_all_shards(app_context_t *app, int priority,
+                              shard_lock_mode_t mode) {
+    for (size_t i = app->shard_count; i-- > 0;) {
+        if (mode == SHARDS_TRACKED) {
+            release_read_lock(app, app->shards[i], priority);
+        } else if (mode == SHARDS_UNTRACKED) {
+            pthread_rwlock_unlock(&app->shards[i]->table_lock);
+        }
+    }
+}
+
+// Runs `collect` on every shard under one consistent set of read locks (or
+// none, for SHARDS_UNLOCKED) and merges the per-shard results, each already
+// sorted by `compare`.
+static size_t gather_shards(app_context_t *app, int priority,
+                            shard_lock_mode_t mode, shard_collect_fn collect,
+                            const void *arg, record_compare_fn compare,
+                            record_snapshot_t **records_out) {
+    *records_out = NULL;
+    if (app->shard_count == 1) {
+        lock_all_shards(app, priority, mode);
+        size_t count = collect(&app->shards[0]->table, arg, records_out);
+        unlock_all_shards(app, priority, mode);
+        return count;
+    }
+
+    record_snapshot_t **parts = (record_snapshot_t **)calloc(
+        app->shard_count, sizeof(record_snapshot_t *));
+    size_t *counts = (size_t *)calloc(app->shard_count, sizeof(size_t));
+    if (!parts || !counts) {
+        free(parts);
+        free(counts);
+        return SIZE_MAX;
+    }
+
+    bool failed = false;
+    lock_all_shards(app, priority, mode);
+    for (size_t i = 0; i < app->shard_count && !failed; ++i) {
+        counts[i] = collect(&app->shards[i]->table, arg, &parts[i]);
+        if (counts[i] == SIZE_MAX) {
+            counts[i] = 0;
+            failed = true;
+        }
+    }
+    unlock_all_shards(app, priority, mode);
+
+    size_t count = SIZE_MAX;
+    if (!failed) {
+        count = merge_snapshots(parts, counts, app->shard_count, compare,
+                                records_out);
+    }
+    for (size_t i = 0; i < app->shard_count; ++i) {
+        free(parts[i]);
+    }
+    free(parts);
+    free(counts);
+    return count;
+}
+
+static size_t collect_snapshot(const hash_table_t *table, const void *arg,
+                               record_snapshot_t **records_out) {
+    (void)arg;
+    return hash_table_snapshot(table, records_out);
+}
+
+static size_t collect_range(const hash_table_t *table, const void *arg,
+                            record_snapshot_t **records_out) {
+    const command_t *cmd = (const command_t *)arg;
+    return hash_table_salary_range(table, cmd->value, cmd->upper, records_out);
+}
+
+static bool hash_before(const record_snapshot_t *a,
+                        const record_snapshot_t *b) {
+    return a->hash < b->hash;
+}
+
+static bool salary_before(const record_snapshot_t *a,
+                          const record_snapshot_t *b) {
+    return salary_index_compare(a, b) < 0;
+}
+
+// Restores the heap below `slot`. heap[] holds part indices ordered by each
+// part's next record.
+static void sift_down(size_t *heap, size_t size, size_t slot,
+                      record_snapshot_t **parts, const size_t *cursor,
+                      record_compare_fn before) {
+    for (;;) {
+        size_t least = slot;
+        for (size_t child = 2 * slot + 1; child <= 2 * slot + 2; ++child) {
+            if (child < size &&
+                before(&parts[heap[child]][cursor[heap[child]]],
+                       &parts[heap[least]][cursor[heap[least]]])) {
+                least = child;
+            }
+        }
+        if (least == slot) {
+            return;
+        }
+        size_t tmp = heap[slot];
+        heap[slot] = heap[least];
+        heap[least] = tmp;
+        slot = least;
+    }
+}
+
+// k-way merge through a binary heap of the parts' next records, so each
+// output record costs O(log parts).
+static size_t merge_snapshots(record_snapshot_t **parts, const size_t *counts,
+                              size_t part_count, record_compare_fn before,
+                              record_snapshot_t **merged) {
+    size_t total = 0;
+    for (size_t i = 0; i < part_count; ++i) {
+        total += counts[i];
+    }
+    if (total == 0) {
+        *merged = NULL;
+        return 0;
+    }
+
+    record_snapshot_t *records =
+        (record_snapshot_t *)malloc(total * sizeof(record_snapshot_t));
+    size_t *cursor = (size_t *)calloc(part_count, sizeof(size_t));
+    size_t *heap = (size_t *)malloc(part_count * sizeof(size_t));
+    if (!records || !cursor || !heap) {
+        free(records);
+        free(cursor);
+        free(heap);
+        *merged = NULL;
+        return SIZE_MAX;
+    }
+
+    size_t size = 0;
+    for (size_t i = 0; i < part_count; ++i) {
+        if (counts[i] > 0) {
+            heap[size++] = i;
+        }
+    }
+    for (size_t slot = size / 2; slot-- > 0;) {
+        sift_down(heap, size, slot, parts, cursor, before);
+    }
+
+    for (size_t out = 0; out < total; ++out) {
+        size_t best = heap[0];
+        records[out] = parts[best][cursor[best]++];
+        if (cursor[best] == counts[best]) {
+            heap[0] = heap[--size];
+        }
+        sift_down(heap, size, 0, parts, cursor, before);
+    }
+
+    free(heap);
+    free(cursor);
+    *merged = records;
+    return total;
+}
+
+static void acquire_read_lock(app_context_t *app, table_shard_t *shard,
+                              int priority) {
+    uint64_t start = trace_now();
+    pthread_rwlock_rdlock(&shard->table_lock);
+    trace_span(TRACE_LOCK_WAIT, start, "read");
+    trace_lock_acquired();
+    atomic_fetch_add_explicit(&app->read_lock_acq, 1, memory_order_relaxed);
+    logger_thread_log(&app->logger, priority, "READ LOCK ACQUIRED");
+}
+
+static void release_read_lock(app_context_t *app, table_shard_t *shard,
+                              int priority) {
+    trace_lock_released("read");
+    pthread_rwlock_unlock(&shard->table_lock);
+    atomic_fetch_add_explicit(&app->read_lock_rel, 1, memory_order_relaxed);
+    logger_thread_log(&app->logger, priority, "READ LOCK RELEASED");
+}
+
+static void acquire_write_lock(app_context_t *app, table_shard_t *shard,
+                               int priority) {
+    uint64_t start = trace_now();
+    pthread_rwlock_wrlock(&shard->table_lock);
+    trace_span(TRACE_LOCK_WAIT, start, "write");
+    trace_lock_acquired();
+    atomic_fetch_add_explicit(&app->write_lock_acq, 1, memory_order_relaxed);
+    logger_thread_log(&app->logger, priority, "WRITE LOCK ACQUIRED");
+}
+
+static void release_write_lock(app_context_t *app, table_shard_t *shard,
+                               int priority) {
+    trace_lock_released("write");
+    pthread_rwlock_unlock(&shard->table_lock);
+    atomic_fetch_add_explicit(&app->write_lock_rel, 1, memory_order_relaxed);
+    logger_thread_log(&app->logger, priority, "WRITE LOCK RELEASED");
+}
+
+void log_final_summary(app_context_t *app) {
+    size_t total_acq = atomic_load(&app->read_lock_acq) +
+                       atomic_load(&app->write_lock_acq);
+    size_t total_rel = atomic_load(&app->read_lock_rel) +
+                       atomic_load(&app->write_lock_rel);
+    logger_log(&app->logger, "Number of lock acquisitions: %zu", total_acq);
+    logger_log(&app->logger, "Number of lock releases: %zu", total_rel);
+
+    record_snapshot_t *records = NULL;
+    size_t count = gather_shards(app, 0,
+                                 HASH_TABLE_CONCURRENT ? SHARDS_UNLOCKED
+                                                       : SHARDS_UNTRACKED,
+                                 collect_snapshot, NULL, hash_before, &records);
+
+    logger_log(&app->logger, "Final Table:");
+    if (count == SIZE_MAX) {
+        return;
+    }
+    if (count == 0 || !records) {
+        return;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        logger_log(&app->logger, "%u,%s,%u", records[i].hash, records[i].name,
+                   records[i].salary);
+    }
+    free(records);
+}
@@ -0,0 +1,401 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "app_context.h"
+#include "hash_table.h"
+
+// Shows what the cache-line layout buys, with hardware counters from
+// perf_event_open(2):
+//   counters  threads bump the four lock counters, laid out packed as they
+//             used to be and padded as in app_context_t
+//   lookups   random finds in a node-per-record list (the old
+//             hash_record_t) and in the hot/cold block table
+// HITM (a load served from a line modified in another core's cache) has no
+// generic perf event. The default raw code is
+// MEM_LOAD_L3_HIT_RETIRED.XSNP_HITM on Intel Skylake through Ice Lake; use
+// -e with the code from `perf list --details` on other CPUs. Counters that
+// cannot be opened (no PMU, perf_event_paranoid) are reported as n/a.
+
+#define DEFAULT_HITM_EVENT 0x04d2
+
+typedef enum {
+    COUNTER_CACHE_MISSES,
+    COUNTER_L1D_MISSES,
+    COUNTER_HITM,
+    COUNTER_COUNT
+} counter_id_t;
+
+static const char *const counter_names[COUNTER_COUNT] = {
+    "cache-misses", "L1D-misses", "HITM"
+};
+
+typedef struct {
+    int fds[COUNTER_COUNT];
+    uint64_t values[COUNTER_COUNT];
+    uint64_t elapsed_ns;
+} counter_set_t;
+
+typedef struct {
+    int threads;
+    long increments;
+    uint32_t keys;
+    long lookups;
+    uint64_t hitm_event;
+} bench_config_t;
+
+// The lock counters as app_context_t used to pack them.
+typedef struct {
+    atomic_size_t read_lock_acq;
+    atomic_size_t read_lock_rel;
+    atomic_size_t write_lock_acq;
+    atomic_size_t write_lock_rel;
+} packed_counters_t;
+
+typedef struct {
+    atomic_size_t *counter;
+    long increments;
+} counter_worker_t;
+
+// The record layout before the hot/cold split.
+typedef struct legacy_record {
+    uint32_t hash;
+    char name[MAX_NAME_LEN];
+    uint32_t salary;
+    struct legacy_record *next;
+} legacy_record_t;
+
+static packed_counters_t packed_counters;
+static app_context_t padded_context;
+
+static int open_counter(uint32_t type, uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.inherit = 1;  // count the worker threads started afterwards
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void counters_open(counter_set_t *set, uint64_t hitm_event) {
+    set->fds[COUNTER_CACHE_MISSES] =
+        open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    set->fds[COUNTER_L1D_MISSES] = open_counter(
+        PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+                                (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    set->fds[COUNTER_HITM] = open_counter(PERF_TYPE_RAW, hitm_event);
+}
+
+static void counters_close(counter_set_t *set) {
+    for (int i = 0; i < COUNTER_COUNT; ++i) {
+        if (set->fds[i] >= 0) {
+            close(set->fds[i]);
+        }
+    }
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void counters_start(counter_set_t *set) {
+    for (int i = 0; i < COUNTER_COUNT; ++i) {
+        if (set->fds[i] >= 0) {
+            ioctl(set->fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(set->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+    set->elapsed_ns = now_ns();
+}
+
+static void counters_stop(counter_set_t *set) {
+    set->elapsed_ns = now_ns() - set->elapsed_ns;
+    for (int i = 0; i < COUNTER_COUNT; ++i) {
+        set->values[i] = 0;
+        if (set->fds[i] >= 0) {
+            ioctl(set->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+            if (read(set->fds[i], &set->values[i], sizeof(uint64_t)) !=
+                (ssize_t)sizeof(uint64_t)) {
+                set->values[i] = 0;
+            }
+        }
+    }
+}
+
+static void print_header(void) {
+    printf("  %-18s %10s", "layout", "time");
+    for (int i = 0; i < COUNTER_COUNT; ++i) {
+        printf(" %14s", counter_names[i]);
+    }
+    printf("   (counters per op)\n");
+}
+
+static void print_row(const char *layout, const counter_set_t *set,
+                      double ops) {
+    printf("  %-18s %8.3f s", layout, (double)set->elapsed_ns / 1e9);
+    for (int i = 0; i < COUNTER_COUNT; ++i) {
+        if (set->fds[i] < 0) {
+            printf(" %14s", "n/a");
+        } else {
+            printf(" %14.4f", (double)set->values[i] / ops);
+        }
+    }
+    printf("\n");
+}
+
+static void *counter_main(void *arg) {
+    counter_worker_t *worker = (counter_worker_t *)arg;
+    for (long i = 0; i < worker->increments; ++i) {
+        atomic_fetch_add_explicit(worker->counter, 1, memory_order_relaxed);
+    }
+    return NULL;
+}
+
+// Thread i bumps counter i % 4, so threads only share a counter when
+// there are more than four of them; everything else is layout.
+static void run_counters(const bench_config_t *config, atomic_size_t **slots,
+                         const char *layout, counter_set_t *set) {
+    counter_worker_t *workers = (counter_worker_t *)calloc(
+        (size_t)config->threads, sizeof(counter_worker_t));
+    pthread_t *threads =
+        (pthread_t *)calloc((size_t)config->threads, sizeof(pthread_t));
+    if (!workers || !threads) {
+        fprintf(stderr, "Failed to allocate workers.\n");
+        free(workers);
+        free(threads);
+        return;
+    }
+
+    counters_start(set);
+    int started = 0;
+    for (; started < config->threads; ++started) {
+        workers[started].counter = slots[started % 4];
+        workers[started].increments = config->increments;
+        if (pthread_create(&threads[started], NULL, counter_main,
+                           &workers[started]) != 0) {
+            fprintf(stderr, "Failed to start thread %d.\n", started);
+            break;
+        }
+    }
+    for (int i = 0; i < started; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    counters_stop(set);
+    print_row(layout, set, (double)config->increments * started);
+
+    free(workers);
+    free(threads);
+}
+
+static uint64_t next_random(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+static uint32_t key_hash(uint32_t key) {
+    return key * 2654435761u;  // distinct for every 32-bit key
+}
+
+static int compare_records(const void *a, const void *b) {
+    uint32_t x = (*(legacy_record_t *const *)a)->hash;
+    uint32_t y = (*(legacy_record_t *const *)b)->hash;
+    return (x > y) - (x < y);
+}
+
+static bool legacy_find(const legacy_record_t *head, uint32_t hash,
+                        record_snapshot_t *result) {
+    while (head && head->hash < hash) {
+        head = head->next;
+    }
+    if (!head || head->hash != hash) {
+        return false;
+    }
+    result->hash = head->hash;
+    strncpy(result->name, head->name, MAX_NAME_LEN);
+    result->salary = head->salary;
+    return true;
+}
+
+// Both tables get the same keys in the same random order, so the legacy
+// nodes are scattered over the heap the way a live table's would be.
+static void run_lookups(const bench_config_t *config, counter_set_t *set) {
+    uint32_t *order = (uint32_t *)malloc(config->keys * sizeof(uint32_t));
+    legacy_record_t **nodes = (legacy_record_t **)calloc(
+        config->keys, sizeof(legacy_record_t *));
+    if (!order || !nodes) {
+        fprintf(stderr, "Failed to allocate the lookup tables.\n");
+        free(order);
+        free(nodes);
+        return;
+    }
+    uint64_t seed = 0x2545F4914F6CDD1Dull;
+    for (uint32_t i = 0; i < config->keys; ++i) {
+        order[i] = i;
+    }
+    for (uint32_t i = config->keys; i > 1; --i) {
+        uint32_t j = (uint32_t)(next_random(&seed) % i);
+        uint32_t tmp = order[i - 1];
+        order[i - 1] = order[j];
+        order[j] = tmp;
+    }
+
+    hash_table_t table;
+    hash_table_init(&table);
+    uint32_t built = 0;
+    for (; built < config->keys; ++built) {
+        uint32_t key = order[built];
+        legacy_record_t *node =
+            (legacy_record_t *)calloc(1, sizeof(legacy_record_t));
+        if (!node || hash_table_insert(&table, key_hash(key), "bench",
+                                       key) != TABLE_OK) {
+            free(node);
+            break;
+        }
+        node->hash = key_hash(key);
+        strncpy(node->name, "bench", MAX_NAME_LEN - 1);
+        node->salary = key;
+        nodes[built] = node;
+    }
+    qsort(nodes, built, sizeof(legacy_record_t *), compare_records);
+    for (uint32_t i = 0; i + 1 < built; ++i) {
+        nodes[i]->next = nodes[i + 1];
+    }
+    legacy_record_t *head = built > 0 ? nodes[0] : NULL;
+
+    long hits = 0;
+    record_snapshot_t found;
+    seed = 0x9E3779B97F4A7C15ull;
+    counters_start(set);
+    for (long i = 0; i < config->lookups; ++i) {
+        uint32_t key = (uint32_t)(next_random(&seed) % config->keys);
+        hits += legacy_find(head, key_hash(key), &found);
+    }
+    counters_stop(set);
+    print_row("node per record", set, (double)config->lookups);
+
+    seed = 0x9E3779B97F4A7C15ull;
+    counters_start(set);
+    for (long i = 0; i < config->lookups; ++i) {
+        uint32_t key = (uint32_t)(next_random(&seed) % config->keys);
+        hits -= hash_table_find(&table, key_hash(key), &found);
+    }
+    counters_stop(set);
+    print_row("hot/cold blocks", set, (double)config->lookups);
+    if (hits != 0) {
+        fprintf(stderr, "Lookup results differ between layouts.\n");
+    }
+
+    for (uint32_t i = 0; i < built; ++i) {
+        free(nodes[i]);
+    }
+    hash_table_destroy(&table);
+    free(nodes);
+    free(order);
+}
+
+static bool parse_long(const char *text, long *value) {
+    char *end = NULL;
+    errno = 0;
+    long parsed = strtol(text, &end, 0);
+    if (errno != 0 || !text[0] || *end || parsed <= 0) {
+        return false;
+    }
+    *value = parsed;
+    return true;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-t THREADS] [-n INCREMENTS_PER_THREAD] [-k KEYS] "
+            "[-l LOOKUPS] [-e HITM_RAW_EVENT]\n",
+            prog);
+}
+
+int main(int argc, char **argv) {
+    bench_config_t config = {
+        .threads = 4,
+        .increments = 20000000,
+        .keys = 16384,
+        .lookups = 50000,
+        .hitm_event = DEFAULT_HITM_EVENT
+    };
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:n:k:l:e:")) != -1) {
+        long value = 0;
+        bool ok = optarg && parse_long(optarg, &value);
+        switch (opt) {
+            case 't':
+                ok = ok && value <= 1024;
+                config.threads = (int)value;
+                break;
+            case 'n':
+                config.increments = value;
+                break;
+            case 'k':
+                ok = ok && value <= UINT32_MAX;
+                config.keys = (uint32_t)value;
+                break;
+            case 'l':
+                config.lookups = value;
+                break;
+            case 'e':
+                config.hitm_event = (uint64_t)value;
+                break;
+            default:
+                ok = false;
+                break;
+        }
+        if (!ok) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    counter_set_t set;
+    counters_open(&set, config.hitm_event);
+
+    printf("counters: %d thread(s), %ld increments each\n", config.threads,
+           config.increments);
+    print_header();
+    atomic_size_t *packed[4] = {
+        &packed_counters.read_lock_acq, &packed_counters.read_lock_rel,
+        &packed_counters.write_lock_acq, &packed_counters.write_lock_rel
+    };
+    atomic_size_t *padded[4] = {
+        &padded_context.read_lock_acq, &padded_context.read_lock_rel,
+        &padded_context.write_lock_acq, &padded_context.write_lock_rel
+    };
+    run_counters(&config, packed, "packed", &set);
+    run_counters(&config, padded, "padded", &set);
+
+    printf("lookups: %u keys, %ld random finds\n", config.keys,
+           config.lookups);
+    print_header();
+    run_lookups(&config, &set);
+
+    counters_close(&set);
+    return EXIT_SUCCESS;
+}
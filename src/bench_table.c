@@ -0,0 +1,288 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hash_table.h"
+
+// Micro-benchmark for the table engine selected at build time (`make bench`
+// builds one binary per engine). Worker threads run a find/insert/update/
+// delete mix while one extra thread keeps taking full snapshots, the way
+// PRINT does. The list engine needs the same reader/writer lock chash wraps
+// it in; the skiplist runs without one.
+
+#if HASH_TABLE_CONCURRENT
+#define ENGINE_NAME "skiplist"
+#else
+#define ENGINE_NAME "list"
+#endif
+
+typedef struct {
+    int threads;
+    long ops;
+    uint32_t keys;
+    uint32_t read_pct;
+    bool snapshots;
+} bench_config_t;
+
+typedef struct {
+    hash_table_t table;
+    pthread_rwlock_t lock;
+    const bench_config_t *config;
+    _Atomic bool stop;
+} bench_state_t;
+
+typedef struct {
+    bench_state_t *state;
+    uint64_t seed;
+    long found;
+    long snapshots;
+} bench_worker_t;
+
+static uint32_t key_hash(uint32_t key) {
+    return key * 2654435761u;  // distinct for every 32-bit key
+}
+
+static uint64_t next_random(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void read_lock(bench_state_t *state) {
+    if (!HASH_TABLE_CONCURRENT) {
+        pthread_rwlock_rdlock(&state->lock);
+    }
+}
+
+static void write_lock(bench_state_t *state) {
+    if (!HASH_TABLE_CONCURRENT) {
+        pthread_rwlock_wrlock(&state->lock);
+    }
+}
+
+static void unlock(bench_state_t *state) {
+    if (!HASH_TABLE_CONCURRENT) {
+        pthread_rwlock_unlock(&state->lock);
+    }
+}
+
+static void *mixed_main(void *arg) {
+    bench_worker_t *worker = (bench_worker_t *)arg;
+    bench_state_t *state = worker->state;
+    const bench_config_t *config = state->config;
+
+    for (long i = 0; i < config->ops; ++i) {
+        uint64_t r = next_random(&worker->seed);
+        uint32_t hash = key_hash((uint32_t)(r % config->keys));
+        uint32_t kind = (uint32_t)((r >> 32) % 100);
+        uint32_t salary = (uint32_t)(r >> 40);
+
+        if (kind < config->read_pct) {
+            record_snapshot_t found;
+            read_lock(state);
+            worker->found += hash_table_find(&state->table, hash, &found);
+            unlock(state);
+        } else {
+            write_lock(state);
+            switch (kind % 3) {
+                case 0:
+                    hash_table_insert(&state->table, hash, "bench", salary);
+                    break;
+                case 1:
+                    hash_table_update(&state->table, hash, salary, NULL, NULL);
+                    break;
+                default:
+                    hash_table_delete(&state->table, hash, NULL);
+                    break;
+            }
+            unlock(state);
+        }
+    }
+    return NULL;
+}
+
+static void *snapshot_main(void *arg) {
+    bench_worker_t *worker = (bench_worker_t *)arg;
+    bench_state_t *state = worker->state;
+
+    while (!state->stop) {
+        record_snapshot_t *records = NULL;
+        read_lock(state);
+        size_t count = hash_table_snapshot(&state->table, &records);
+        unlock(state);
+        if (count == SIZE_MAX) {
+            fprintf(stderr, "Snapshot failed.\n");
+            break;
+        }
+        free(records);
+        worker->snapshots++;
+    }
+    return NULL;
+}
+
+static bool parse_long(const char *text, long *value) {
+    char *end = NULL;
+    long parsed = strtol(text, &end, 10);
+    if (!text[0] || *end || parsed <= 0) {
+        return false;
+    }
+    *value = parsed;
+    return true;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-t THREADS] [-n OPS_PER_THREAD] [-k KEYS] "
+            "[-r READ_PERCENT] [-S]\n",
+            prog);
+}
+
+int main(int argc, char **argv) {
+    bench_config_t config = {
+        .threads = 4,
+        .ops = 100000,
+        .keys = 10000,
+        .read_pct = 90,
+        .snapshots = true
+    };
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:n:k:r:S")) != -1) {
+        long value = 0;
+        bool ok = optarg && parse_long(optarg, &value);
+        switch (opt) {
+            case 't':
+                ok = ok && value <= 1024;
+                config.threads = (int)value;
+                break;
+            case 'n':
+                config.ops = value;
+                break;
+            case 'k':
+                ok = ok && value <= UINT32_MAX;
+                config.keys = (uint32_t)value;
+                break;
+            case 'r':
+                // 0 is a valid read share, which parse_long rejects.
+                ok = strcmp(optarg, "0") == 0 || (ok && value <= 100);
+                config.read_pct = (uint32_t)value;
+                break;
+            case 'S':
+                // Measure the operations alone, without a snapshot thread.
+                config.snapshots = false;
+                ok = true;
+                break;
+            default:
+                ok = false;
+                break;
+        }
+        if (!ok) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    bench_state_t state;
+    hash_table_init(&state.table);
+    pthread_rwlock_init(&state.lock, NULL);
+    state.config = &config;
+    state.stop = false;
+
+    // Half the key space is present when the mixed phase starts, so finds
+    // hit about half the time and inserts/deletes mostly succeed.
+    uint64_t start = now_ns();
+    for (uint32_t key = 0; key < config.keys; key += 2) {
+        hash_table_insert(&state.table, key_hash(key), "bench", key);
+    }
+    uint64_t preload_ns = now_ns() - start;
+
+    bench_worker_t *workers = (bench_worker_t *)calloc(
+        (size_t)config.threads + 1, sizeof(bench_worker_t));
+    pthread_t *threads =
+        (pthread_t *)calloc((size_t)config.threads + 1, sizeof(pthread_t));
+    if (!workers || !threads) {
+        fprintf(stderr, "Failed to allocate workers.\n");
+        free(workers);
+        free(threads);
+        hash_table_destroy(&state.table);
+        return EXIT_FAILURE;
+    }
+
+    bench_worker_t *snapshotter = &workers[config.threads];
+    snapshotter->state = &state;
+    if (config.snapshots &&
+        pthread_create(&threads[config.threads], NULL, snapshot_main,
+                       snapshotter) != 0) {
+        fprintf(stderr, "Failed to start snapshot thread.\n");
+        free(workers);
+        free(threads);
+        hash_table_destroy(&state.table);
+        return EXIT_FAILURE;
+    }
+
+    start = now_ns();
+    int started = 0;
+    for (; started < config.threads; ++started) {
+        bench_worker_t *worker = &workers[started];
+        worker->state = &state;
+        worker->seed = 0x9E3779B97F4A7C15ull * (uint64_t)(started + 1);
+        if (pthread_create(&threads[started], NULL, mixed_main, worker) != 0) {
+            fprintf(stderr, "Failed to start worker %d.\n", started);
+            break;
+        }
+    }
+    for (int i = 0; i < started; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    uint64_t mixed_ns = now_ns() - start;
+    state.stop = true;
+    if (config.snapshots) {
+        pthread_join(threads[config.threads], NULL);
+    }
+
+    // The final snapshot must come out in hash order and agree with the
+    // running count.
+    record_snapshot_t *records = NULL;
+    size_t count = hash_table_snapshot(&state.table, &records);
+    table_stats_t stats;
+    hash_table_stats(&state.table, &stats);
+    bool ordered = count != SIZE_MAX && count == stats.count;
+    for (size_t i = 1; ordered && i < count; ++i) {
+        ordered = records[i - 1].hash < records[i].hash;
+    }
+    free(records);
+
+    long total_ops = config.ops * started;
+    printf("engine:      %s\n", ENGINE_NAME);
+    printf("preload:     %u keys in %.3f s (%.0f inserts/s)\n",
+           (config.keys + 1) / 2, (double)preload_ns / 1e9,
+           (double)((config.keys + 1) / 2) / ((double)preload_ns / 1e9));
+    printf("mixed:       %ld ops on %d thread(s), %u%% reads, %.3f s "
+           "(%.0f ops/s)\n",
+           total_ops, started, config.read_pct, (double)mixed_ns / 1e9,
+           (double)total_ops / ((double)mixed_ns / 1e9));
+    printf("snapshots:   %ld taken during the mixed phase\n",
+           snapshotter->snapshots);
+    printf("final table: %zu records, %s\n", stats.count,
+           ordered ? "ordered" : "CORRUPT");
+
+    free(workers);
+    free(threads);
+    pthread_rwlock_destroy(&state.lock);
+    hash_table_destroy(&state.table);
+    return ordered ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,335 @@
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "command.h"
+
+// Load generator for `chash -u`/`chash -p`. Every connection keeps `depth`
+// requests in flight: it writes a window of requests in one go, then reads
+// the responses (each terminated by an empty line) before sending the next.
+
+typedef struct {
+    const char *unix_path;
+    int tcp_port;
+    int connections;
+    int requests;
+    int depth;
+    uint32_t keys;
+    uint32_t read_pct;
+} load_config_t;
+
+typedef struct {
+    const load_config_t *config;
+    int id;
+    uint64_t seed;
+    uint64_t *latencies_ns;
+    int completed;
+    bool failed;
+} client_t;
+
+static int connect_server(const load_config_t *config);
+static void *client_main(void *arg);
+static uint64_t next_random(uint64_t *state);
+static uint64_t now_ns(void);
+static int compare_u64(const void *a, const void *b);
+static void usage(const char *prog);
+
+int main(int argc, char **argv) {
+    load_config_t config = {
+        .unix_path = NULL,
+        .tcp_port = 0,
+        .connections = 4,
+        .requests = 100000,
+        .depth = 16,
+        .keys = 10000,
+        .read_pct = 80
+    };
+
+    int opt;
+    while ((opt = getopt(argc, argv, "u:p:c:n:d:k:r:")) != -1) {
+        bool ok = true;
+        switch (opt) {
+            case 'u':
+                config.unix_path = optarg;
+                break;
+            case 'p':
+                ok = parse_int(optarg, &config.tcp_port) &&
+                     config.tcp_port > 0 && config.tcp_port <= 65535;
+                break;
+            case 'c':
+                ok = parse_int(optarg, &config.connections) &&
+                     config.connections > 0;
+                break;
+            case 'n':
+                ok = parse_int(optarg, &config.requests) && config.requests > 0;
+                break;
+            case 'd':
+                ok = parse_int(optarg, &config.depth) && config.depth > 0;
+                break;
+            case 'k':
+                ok = parse_uint32(optarg, &config.keys) && config.keys > 0;
+                break;
+            case 'r':
+                ok = parse_uint32(optarg, &config.read_pct) &&
+                     config.read_pct <= 100;
+                break;
+            default:
+                ok = false;
+                break;
+        }
+        if (!ok) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (!config.unix_path == (config.tcp_port == 0)) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    client_t *clients =
+        (client_t *)calloc((size_t)config.connections, sizeof(client_t));
+    pthread_t *threads =
+        (pthread_t *)calloc((size_t)config.connections, sizeof(pthread_t));
+    if (!clients || !threads) {
+        fprintf(stderr, "Failed to allocate clients.\n");
+        free(clients);
+        free(threads);
+        return EXIT_FAILURE;
+    }
+
+    uint64_t start = now_ns();
+    int started = 0;
+    for (; started < config.connections; ++started) {
+        client_t *client = &clients[started];
+        client->config = &config;
+        client->id = started;
+        client->seed = 0x9E3779B97F4A7C15ull * (uint64_t)(started + 1);
+        if (pthread_create(&threads[started], NULL, client_main, client) != 0) {
+            fprintf(stderr, "Failed to start client %d.\n", started);
+            break;
+        }
+    }
+    for (int i = 0; i < started; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    uint64_t elapsed = now_ns() - start;
+
+    size_t total = 0;
+    for (int i = 0; i < started; ++i) {
+        total += (size_t)clients[i].completed;
+    }
+
+    uint64_t *all = (uint64_t *)malloc((total ? total : 1) * sizeof(uint64_t));
+    if (!all) {
+        fprintf(stderr, "Failed to allocate latency table.\n");
+        total = 0;
+    }
+    size_t idx = 0;
+    int failures = 0;
+    for (int i = 0; i < started; ++i) {
+        if (all) {
+            memcpy(all + idx, clients[i].latencies_ns,
+                   (size_t)clients[i].completed * sizeof(uint64_t));
+            idx += (size_t)clients[i].completed;
+        }
+        failures += clients[i].failed ? 1 : 0;
+        free(clients[i].latencies_ns);
+    }
+
+    double seconds = (double)elapsed / 1e9;
+    printf("requests:    %zu over %d connection(s), pipeline depth %d\n",
+           total, started, config.depth);
+    printf("elapsed:     %.3f s\n", seconds);
+    printf("throughput:  %.0f req/s\n",
+           seconds > 0 ? (double)total / seconds : 0.0);
+    if (total > 0) {
+        qsort(all, total, sizeof(uint64_t), compare_u64);
+        printf("latency us:  p50 %.1f  p90 %.1f  p99 %.1f  max %.1f\n",
+               (double)all[total / 2] / 1e3,
+               (double)all[total * 9 / 10] / 1e3,
+               (double)all[total * 99 / 100] / 1e3,
+               (double)all[total - 1] / 1e3);
+    }
+    if (failures > 0) {
+        printf("failed connections: %d\n", failures);
+    }
+
+    free(all);
+    free(clients);
+    free(threads);
+    return failures > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static void *client_main(void *arg) {
+    client_t *client = (client_t *)arg;
+    const load_config_t *config = client->config;
+
+    client->latencies_ns =
+        (uint64_t *)calloc((size_t)config->requests, sizeof(uint64_t));
+    size_t out_cap = (size_t)config->depth * MAX_LINE_LEN;
+    char *out = (char *)malloc(out_cap);
+    char in[65536];
+    int fd = connect_server(config);
+    if (!client->latencies_ns || !out || fd < 0) {
+        client->failed = true;
+        free(out);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return NULL;
+    }
+
+    int priority = 0;
+    while (client->completed < config->requests) {
+        int window = config->requests - client->completed;
+        if (window > config->depth) {
+            window = config->depth;
+        }
+
+        size_t out_len = 0;
+        for (int i = 0; i < window; ++i) {
+            uint64_t r = next_random(&client->seed);
+            uint32_t key = (uint32_t)(r % config->keys);
+            uint32_t salary = (uint32_t)((r >> 32) % 200000);
+            uint32_t kind = (uint32_t)((r >> 20) % 100);
+            const char *verb;
+            if (kind < config->read_pct) {
+                verb = "search";
+            } else if ((kind & 3) == 0) {
+                verb = "delete";
+            } else if ((kind & 1) == 0) {
+                verb = "update";
+            } else {
+                verb = "insert";
+            }
+            out_len += (size_t)snprintf(out + out_len, out_cap - out_len,
+                                        "%s,key%u,%u,%d\n", verb, key, salary,
+                                        priority++);
+        }
+
+        uint64_t sent = now_ns();
+        size_t off = 0;
+        while (off < out_len) {
+            ssize_t n = send(fd, out + off, out_len - off, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                client->failed = true;
+                goto done;
+            }
+            off += (size_t)n;
+        }
+
+        int answered = 0;
+        char prev = '\0';
+        while (answered < window) {
+            ssize_t n = read(fd, in, sizeof(in));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                client->failed = true;
+                goto done;
+            }
+            uint64_t arrived = now_ns();
+            for (ssize_t i = 0; i < n; ++i) {
+                if (in[i] == '\n' && prev == '\n') {
+                    client->latencies_ns[client->completed++] = arrived - sent;
+                    answered++;
+                    prev = '\0';
+                } else {
+                    prev = in[i];
+                }
+            }
+        }
+    }
+
+done:
+    free(out);
+    close(fd);
+    return NULL;
+}
+
+static int connect_server(const load_config_t *config) {
+    int fd;
+    if (config->unix_path) {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, config->unix_path, sizeof(addr.sun_path) - 1);
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            return -1;
+        }
+        if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+            fprintf(stderr, "Unable to connect to %s: %s\n", config->unix_path,
+                    strerror(errno));
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)config->tcp_port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "Unable to connect to port %d: %s\n", config->tcp_port,
+                strerror(errno));
+        close(fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+static uint64_t next_random(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s (-u SOCKET_PATH | -p TCP_PORT) [-c CONNECTIONS] "
+            "[-n REQUESTS_PER_CONNECTION] [-d PIPELINE_DEPTH] [-k KEYS] "
+            "[-r READ_PERCENT]\n",
+            prog);
+}
@@ -0,0 +1,189 @@
+#include "command.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+char *trim(char *str) {
+    char *start = str;
+    while (*start && isspace((unsigned char)*start)) {
+        start++;
+    }
+
+    if (*start == '\0') {
+        return start;
+    }
+
+    char *end = start + strlen(start) - 1;
+    while (end > start && isspace((unsigned char)*end)) {
+        *end = '\0';
+        --end;
+    }
+
+    return start;
+}
+
+bool parse_uint32(const char *token, uint32_t *value) {
+    errno = 0;
+    char *end = NULL;
+    unsigned long parsed = strtoul(token, &end, 10);
+    if (errno != 0 || *end != '\0' || parsed > UINT32_MAX) {
+        return false;
+    }
+    *value = (uint32_t)parsed;
+    return true;
+}
+
+bool parse_int(const char *token, int *value) {
+    errno = 0;
+    char *end = NULL;
+    long parsed = strtol(token, &end, 10);
+    if (errno != 0 || *end != '\0' || parsed < 0 || parsed > INT32_MAX) {
+        return false;
+    }
+    *value = (int)parsed;
+    return true;
+}
+
+int parse_command_line(char *line, command_t *command) {
+    char buffer[MAX_LINE_LEN];
+    strncpy(buffer, line, sizeof(buffer) - 1);
+    buffer[sizeof(buffer) - 1] = '\0';
+
+    char *tokens[4] = {0};
+    int count = 0;
+    // Server workers parse concurrently, so the cursor must stay local.
+    char *save = NULL;
+    char *token = strtok_r(buffer, ",\r\n", &save);
+    while (token && count < 4) {
+        tokens[count++] = trim(token);
+        token = strtok_r(NULL, ",\r\n", &save);
+    }
+
+    if (count == 0) {
+        return -1;
+    }
+
+    const char *cmd = tokens[0];
+
+    if (strcmp(cmd, "insert") == 0) {
+        if (count < 4) {
+            return -1;
+        }
+        command->type = CMD_INSERT;
+        strncpy(command->name, tokens[1], MAX_NAME_LEN - 1);
+        command->name[MAX_NAME_LEN - 1] = '\0';
+        if (!parse_uint32(tokens[2], &command->value)) {
+            return -1;
+        }
+        if (!parse_int(tokens[3], &command->priority)) {
+            return -1;
+        }
+        return 0;
+    }
+
+    if (strcmp(cmd, "delete") == 0) {
+        if (count < 4) {
+            return -1;
+        }
+        command->type = CMD_DELETE;
+        strncpy(command->name, tokens[1], MAX_NAME_LEN - 1);
+        command->name[MAX_NAME_LEN - 1] = '\0';
+        if (!parse_int(tokens[3], &command->priority)) {
+            return -1;
+        }
+        command->value = 0;
+        return 0;
+    }
+
+    if (strcmp(cmd, "update") == 0) {
+        if (count < 4) {
+            return -1;
+        }
+        command->type = CMD_UPDATE;
+        strncpy(command->name, tokens[1], MAX_NAME_LEN - 1);
+        command->name[MAX_NAME_LEN - 1] = '\0';
+        if (!parse_uint32(tokens[2], &command->value)) {
+            return -1;
+        }
+        if (!parse_int(tokens[3], &command->priority)) {
+            return -1;
+        }
+        return 0;
+    }
+
+    if (strcmp(cmd, "search") == 0) {
+        if (count < 4) {
+            return -1;
+        }
+        command->type = CMD_SEARCH;
+        strncpy(command->name, tokens[1], MAX_NAME_LEN - 1);
+        command->name[MAX_NAME_LEN - 1] = '\0';
+        if (!parse_int(tokens[3], &command->priority)) {
+            return -1;
+        }
+        command->value = 0;
+        return 0;
+    }
+
+    if (strcmp(cmd, "range") == 0) {
+        if (count < 4) {
+            return -1;
+        }
+        command->type = CMD_RANGE;
+        command->name[0] = '\0';
+        if (!parse_uint32(tokens[1], &command->value) ||
+            !parse_uint32(tokens[2], &command->upper)) {
+            return -1;
+        }
+        if (!parse_int(tokens[3], &command->priority)) {
+            return -1;
+        }
+        return 0;
+    }
+
+    if (strcmp(cmd, "stats") == 0) {
+        command->type = CMD_STATS;
+        command->name[0] = '\0';
+        const char *priority_token = tokens[count - 1];
+        if (!parse_int(priority_token, &command->priority)) {
+            return -1;
+        }
+        command->value = 0;
+        return 0;
+    }
+
+    if (strcmp(cmd, "print") == 0) {
+        command->type = CMD_PRINT;
+        command->name[0] = '\0';
+        const char *priority_token = tokens[count - 1];
+        if (!parse_int(priority_token, &command->priority)) {
+            return -1;
+        }
+        command->value = 0;
+        return 0;
+    }
+
+    return -1;
+}
+
+const char *command_name(command_type_t type) {
+    switch (type) {
+        case CMD_INSERT:
+            return "INSERT";
+        case CMD_DELETE:
+            return "DELETE";
+        case CMD_UPDATE:
+            return "UPDATE";
+        case CMD_SEARCH:
+            return "SEARCH";
+        case CMD_PRINT:
+            return "PRINT";
+        case CMD_RANGE:
+            return "RANGE";
+        case CMD_STATS:
+            return "STATS";
+    }
+    return "UNKNOWN";
+}
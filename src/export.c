@@ -0,0 +1,342 @@
+#include "export.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define EXPORT_CHUNK_RECORDS 8192
+// Longest formatted record: two 10-digit numbers plus the name, which may
+// double in size when CSV escapes every character as "".
+#define TEXT_RECORD_MAX (10 + 1 + (MAX_NAME_LEN - 1) + 1 + 10 + 1)
+#define CSV_RECORD_MAX (10 + 1 + 2 + 2 * (MAX_NAME_LEN - 1) + 1 + 10 + 1)
+#define BINARY_RECORD_SIZE (4 + 4 + MAX_NAME_LEN)
+
+typedef struct {
+    char *data;
+    size_t len;
+    bool ready;
+} export_slot_t;
+
+typedef struct {
+    const record_snapshot_t *records;
+    size_t count;
+    export_format_t format;
+    size_t chunk_count;
+    export_slot_t *slots;
+    size_t slot_count;
+    pthread_mutex_t mutex;
+    pthread_cond_t chunk_ready;
+    pthread_cond_t slot_free;
+    size_t next_chunk;  // next chunk a formatter claims
+    size_t written;     // chunks already handed to the stream
+    bool failed;
+} export_job_t;
+
+static const char digit_pairs[] =
+    "000102030405060708091011121314151617181920212223242526272829"
+    "303132333435363738394041424344454647484950515253545556575859"
+    "606162636465666768697071727374757677787980818283848586878889"
+    "90919293949596979899";
+
+// Writes `value` in decimal and returns the end of the digits.
+static char *format_u32(char *dst, uint32_t value) {
+    char tmp[10];
+    char *p = tmp + sizeof(tmp);
+    while (value >= 100) {
+        uint32_t pair = (value % 100) * 2;
+        value /= 100;
+        *--p = digit_pairs[pair + 1];
+        *--p = digit_pairs[pair];
+    }
+    if (value >= 10) {
+        *--p = digit_pairs[value * 2 + 1];
+        *--p = digit_pairs[value * 2];
+    } else {
+        *--p = (char)('0' + value);
+    }
+    size_t len = (size_t)(tmp + sizeof(tmp) - p);
+    memcpy(dst, p, len);
+    return dst + len;
+}
+
+static char *put_le32(char *dst, uint32_t value) {
+    dst[0] = (char)(value & 0xFF);
+    dst[1] = (char)((value >> 8) & 0xFF);
+    dst[2] = (char)((value >> 16) & 0xFF);
+    dst[3] = (char)((value >> 24) & 0xFF);
+    return dst + 4;
+}
+
+static size_t name_length(const record_snapshot_t *record) {
+    const char *end = memchr(record->name, '\0', MAX_NAME_LEN);
+    return end ? (size_t)(end - record->name) : MAX_NAME_LEN;
+}
+
+static char *format_name_csv(char *dst, const char *name, size_t len) {
+    if (!memchr(name, ',', len) && !memchr(name, '"', len) &&
+        !memchr(name, '\n', len)) {
+        memcpy(dst, name, len);
+        return dst + len;
+    }
+    *dst++ = '"';
+    for (size_t i = 0; i < len; ++i) {
+        if (name[i] == '"') {
+            *dst++ = '"';
+        }
+        *dst++ = name[i];
+    }
+    *dst++ = '"';
+    return dst;
+}
+
+static size_t record_max(export_format_t format) {
+    switch (format) {
+        case EXPORT_CSV:
+            return CSV_RECORD_MAX;
+        case EXPORT_BINARY:
+            return BINARY_RECORD_SIZE;
+        case EXPORT_TEXT:
+        default:
+            return TEXT_RECORD_MAX;
+    }
+}
+
+// Formats `count` records into `dst` and returns the number of bytes.
+static size_t format_chunk(char *dst, const record_snapshot_t *records,
+                           size_t count, export_format_t format) {
+    char *p = dst;
+    for (size_t i = 0; i < count; ++i) {
+        const record_snapshot_t *record = &records[i];
+        size_t len = name_length(record);
+        if (format == EXPORT_BINARY) {
+            p = put_le32(p, record->hash);
+            p = put_le32(p, record->salary);
+            memcpy(p, record->name, len);
+            memset(p + len, 0, MAX_NAME_LEN - len);
+            p += MAX_NAME_LEN;
+            continue;
+        }
+
+        p = format_u32(p, record->hash);
+        *p++ = ',';
+        if (format == EXPORT_CSV) {
+            p = format_name_csv(p, record->name, len);
+        } else {
+            memcpy(p, record->name, len);
+            p += len;
+        }
+        *p++ = ',';
+        p = format_u32(p, record->salary);
+        *p++ = '\n';
+    }
+    return (size_t)(p - dst);
+}
+
+static size_t chunk_records(const export_job_t *job, size_t chunk) {
+    size_t first = chunk * EXPORT_CHUNK_RECORDS;
+    size_t left = job->count - first;
+    return left < EXPORT_CHUNK_RECORDS ? left : EXPORT_CHUNK_RECORDS;
+}
+
+static void *formatter_main(void *arg) {
+    export_job_t *job = (export_job_t *)arg;
+
+    pthread_mutex_lock(&job->mutex);
+    for (;;) {
+        // A slot is reused only after the writer has flushed its last chunk.
+        while (!job->failed && job->next_chunk < job->chunk_count &&
+               job->next_chunk >= job->written + job->slot_count) {
+            pthread_cond_wait(&job->slot_free, &job->mutex);
+        }
+        if (job->failed || job->next_chunk >= job->chunk_count) {
+            break;
+        }
+        size_t chunk = job->next_chunk++;
+        pthread_mutex_unlock(&job->mutex);
+
+        export_slot_t *slot = &job->slots[chunk % job->slot_count];
+        slot->len = format_chunk(
+            slot->data, job->records + chunk * EXPORT_CHUNK_RECORDS,
+            chunk_records(job, chunk), job->format);
+
+        pthread_mutex_lock(&job->mutex);
+        slot->ready = true;
+        pthread_cond_broadcast(&job->chunk_ready);
+    }
+    pthread_mutex_unlock(&job->mutex);
+    return NULL;
+}
+
+static int write_header(FILE *out, size_t count, export_format_t format) {
+    if (format == EXPORT_CSV) {
+        return fputs("hash,name,salary\n", out) == EOF ? -1 : 0;
+    }
+    if (format == EXPORT_BINARY) {
+        char header[16];
+        memcpy(header, EXPORT_BINARY_MAGIC, 8);
+        put_le32(header + 8, (uint32_t)((uint64_t)count & 0xFFFFFFFFu));
+        put_le32(header + 12, (uint32_t)((uint64_t)count >> 32));
+        return fwrite(header, 1, sizeof(header), out) == sizeof(header) ? 0
+                                                                        : -1;
+    }
+    return 0;
+}
+
+static int export_serial(FILE *out, const record_snapshot_t *records,
+                         size_t count, export_format_t format) {
+    if (count == 0) {
+        return 0;
+    }
+    size_t chunk = count < EXPORT_CHUNK_RECORDS ? count : EXPORT_CHUNK_RECORDS;
+    char *buffer = (char *)malloc(chunk * record_max(format));
+    if (!buffer) {
+        return -1;
+    }
+    int rc = 0;
+    for (size_t first = 0; first < count && rc == 0; first += chunk) {
+        size_t n = count - first < chunk ? count - first : chunk;
+        size_t len = format_chunk(buffer, records + first, n, format);
+        rc = fwrite(buffer, 1, len, out) == len ? 0 : -1;
+    }
+    free(buffer);
+    return rc;
+}
+
+// Writes chunks in order as the formatters finish them.
+static int drain_chunks(export_job_t *job, FILE *out) {
+    for (size_t chunk = 0; chunk < job->chunk_count; ++chunk) {
+        export_slot_t *slot = &job->slots[chunk % job->slot_count];
+        pthread_mutex_lock(&job->mutex);
+        while (!slot->ready) {
+            pthread_cond_wait(&job->chunk_ready, &job->mutex);
+        }
+        pthread_mutex_unlock(&job->mutex);
+
+        bool ok = fwrite(slot->data, 1, slot->len, out) == slot->len;
+
+        pthread_mutex_lock(&job->mutex);
+        slot->ready = false;
+        job->written++;
+        if (!ok) {
+            job->failed = true;
+        }
+        pthread_cond_broadcast(&job->slot_free);
+        pthread_mutex_unlock(&job->mutex);
+        if (!ok) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int export_records(FILE *out, const record_snapshot_t *records, size_t count,
+                   export_format_t format, int threads) {
+    if (write_header(out, count, format) != 0) {
+        return -1;
+    }
+
+    if (threads <= 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? (int)online : 1;
+    }
+    size_t chunk_count =
+        (count + EXPORT_CHUNK_RECORDS - 1) / EXPORT_CHUNK_RECORDS;
+    if ((size_t)threads > chunk_count) {
+        threads = (int)chunk_count;
+    }
+    if (threads <= 1) {
+        return export_serial(out, records, count, format);
+    }
+
+    export_job_t job = {
+        .records = records,
+        .count = count,
+        .format = format,
+        .chunk_count = chunk_count,
+        .slot_count = 2 * (size_t)threads,
+        .next_chunk = 0,
+        .written = 0,
+        .failed = false
+    };
+    job.slots = (export_slot_t *)calloc(job.slot_count, sizeof(export_slot_t));
+    pthread_t *workers =
+        (pthread_t *)calloc((size_t)threads, sizeof(pthread_t));
+    if (!job.slots || !workers) {
+        free(job.slots);
+        free(workers);
+        return -1;
+    }
+    size_t slot_size = EXPORT_CHUNK_RECORDS * record_max(format);
+    for (size_t i = 0; i < job.slot_count; ++i) {
+        job.slots[i].data = (char *)malloc(slot_size);
+        if (!job.slots[i].data) {
+            for (size_t j = 0; j < i; ++j) {
+                free(job.slots[j].data);
+            }
+            free(job.slots);
+            free(workers);
+            return -1;
+        }
+    }
+    pthread_mutex_init(&job.mutex, NULL);
+    pthread_cond_init(&job.chunk_ready, NULL);
+    pthread_cond_init(&job.slot_free, NULL);
+
+    int started = 0;
+    for (; started < threads; ++started) {
+        if (pthread_create(&workers[started], NULL, formatter_main, &job) !=
+            0) {
+            break;
+        }
+    }
+
+    int rc;
+    if (started == 0) {
+        rc = export_serial(out, records, count, format);
+    } else {
+        rc = drain_chunks(&job, out);
+    }
+    for (int i = 0; i < started; ++i) {
+        pthread_join(workers[i], NULL);
+    }
+
+    pthread_mutex_destroy(&job.mutex);
+    pthread_cond_destroy(&job.chunk_ready);
+    pthread_cond_destroy(&job.slot_free);
+    for (size_t i = 0; i < job.slot_count; ++i) {
+        free(job.slots[i].data);
+    }
+    free(job.slots);
+    free(workers);
+    return rc;
+}
+
+int export_to_file(const char *path, const record_snapshot_t *records,
+                   size_t count, export_format_t format, int threads) {
+    FILE *file = fopen(path, format == EXPORT_BINARY ? "wb" : "w");
+    if (!file) {
+        return -1;
+    }
+    // Chunks are already large; let them go straight to write(2).
+    setvbuf(file, NULL, _IONBF, 0);
+    int rc = export_records(file, records, count, format, threads);
+    if (fclose(file) != 0) {
+        rc = -1;
+    }
+    return rc;
+}
+
+bool export_parse_format(const char *text, export_format_t *format) {
+    if (strcmp(text, "text") == 0) {
+        *format = EXPORT_TEXT;
+    } else if (strcmp(text, "csv") == 0) {
+        *format = EXPORT_CSV;
+    } else if (strcmp(text, "bin") == 0) {
+        *format = EXPORT_BINARY;
+    } else {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,200 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "generic_table.h"
+
+// Second instantiation of generic_table.h: the SKU stock table from the
+// header's example, with a string key and a deliberately narrow hash. With
+// SKU_HASH_BUCKETS distinct hashes, every hash is shared by hundreds of
+// keys, so ordering by compare_fn and equal-hash runs that span blocks are
+// on the path of nearly every operation. `make check` runs a random
+// insert/find/remove mix against a plain array and walks the whole table
+// after every round.
+
+#define SKU_CODE_LEN 16
+#define SKU_COUNT 4000
+#define SKU_HASH_BUCKETS 16
+#define CHECK_ROUNDS 200
+#define CHECK_OPS_PER_ROUND 1000
+
+typedef struct {
+    char code[SKU_CODE_LEN];
+} sku_t;
+
+GENERIC_TABLE_DECLARE(stock_table, sku_t, uint32_t)
+
+static inline uint32_t sku_hash(const sku_t *sku) {
+    uint32_t sum = 0;
+    for (size_t i = 0; i < SKU_CODE_LEN && sku->code[i]; ++i) {
+        sum += (unsigned char)sku->code[i];
+    }
+    return (sum * 2654435761u) % SKU_HASH_BUCKETS;
+}
+
+static inline int sku_compare(const sku_t *a, const sku_t *b) {
+    return strncmp(a->code, b->code, SKU_CODE_LEN);
+}
+
+GENERIC_TABLE_DEFINE(stock_table, sku_t, uint32_t, sku_hash, sku_compare)
+
+typedef struct {
+    bool present[SKU_COUNT];
+    uint32_t stock[SKU_COUNT];
+    size_t count;
+} reference_t;
+
+static uint64_t next_random(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+static void make_sku(sku_t *sku, size_t id) {
+    memset(sku, 0, sizeof(*sku));
+    snprintf(sku->code, sizeof(sku->code), "SKU-%05zu", id);
+}
+
+static bool sku_id(const sku_t *sku, size_t *id) {
+    unsigned long parsed = 0;
+    if (sscanf(sku->code, "SKU-%lu", &parsed) != 1 || parsed >= SKU_COUNT) {
+        return false;
+    }
+    *id = (size_t)parsed;
+    return true;
+}
+
+static bool run_op(stock_table_t *table, reference_t *ref, uint64_t *seed) {
+    uint64_t r = next_random(seed);
+    size_t id = (size_t)(r % SKU_COUNT);
+    uint32_t stock = (uint32_t)(r >> 32);
+    sku_t sku;
+    make_sku(&sku, id);
+
+    switch ((r >> 24) % 3) {
+        case 0: {
+            stock_table_entry_t *entry = NULL;
+            generic_table_status_t status =
+                stock_table_insert(table, &sku, &stock, &entry);
+            if (ref->present[id]) {
+                return status == GENERIC_TABLE_DUPLICATE;
+            }
+            if (status != GENERIC_TABLE_OK || !entry ||
+                sku_compare(&entry->key, &sku) != 0 || entry->value != stock) {
+                return false;
+            }
+            ref->present[id] = true;
+            ref->stock[id] = stock;
+            ref->count++;
+            return true;
+        }
+        case 1: {
+            stock_table_entry_t *entry = stock_table_find(table, &sku);
+            if (!ref->present[id]) {
+                return entry == NULL;
+            }
+            if (!entry || sku_compare(&entry->key, &sku) != 0 ||
+                entry->value != ref->stock[id]) {
+                return false;
+            }
+            entry->value = stock;  // values are updated in place
+            ref->stock[id] = stock;
+            return true;
+        }
+        default: {
+            uint32_t removed = 0;
+            generic_table_status_t status =
+                stock_table_remove(table, &sku, &removed);
+            if (!ref->present[id]) {
+                return status == GENERIC_TABLE_NOT_FOUND;
+            }
+            if (status != GENERIC_TABLE_OK || removed != ref->stock[id]) {
+                return false;
+            }
+            ref->present[id] = false;
+            ref->count--;
+            return true;
+        }
+    }
+}
+
+// Walks every entry: (hash, key) must strictly increase, stored hashes must
+// match their keys, and the contents must equal the reference.
+static bool verify_table(const stock_table_t *table, const reference_t *ref) {
+    size_t seen = 0;
+    bool have_prev = false;
+    uint32_t prev_hash = 0;
+    sku_t prev_key;
+    stock_table_iter_t iter;
+    for (stock_table_entry_t *entry = stock_table_first(table, &iter); entry;
+         entry = stock_table_next(&iter)) {
+        uint32_t hash = iter.block->hashes[iter.index];
+        size_t id = 0;
+        if (iter.block->count == 0 ||
+            iter.block->count > GENERIC_TABLE_BLOCK_ENTRIES ||
+            hash != sku_hash(&entry->key) || !sku_id(&entry->key, &id) ||
+            !ref->present[id] || ref->stock[id] != entry->value) {
+            return false;
+        }
+        if (have_prev && (hash < prev_hash ||
+                          (hash == prev_hash &&
+                           sku_compare(&prev_key, &entry->key) >= 0))) {
+            return false;
+        }
+        have_prev = true;
+        prev_hash = hash;
+        prev_key = entry->key;
+        seen++;
+    }
+    return seen == ref->count && table->count == ref->count;
+}
+
+int main(void) {
+    reference_t *ref = (reference_t *)calloc(1, sizeof(reference_t));
+    if (!ref) {
+        fprintf(stderr, "Failed to allocate the reference table.\n");
+        return EXIT_FAILURE;
+    }
+    stock_table_t table;
+    stock_table_init(&table);
+
+    uint64_t seed = 0x9E3779B97F4A7C15ull;
+    bool ok = true;
+    for (int round = 0; round < CHECK_ROUNDS && ok; ++round) {
+        for (int op = 0; op < CHECK_OPS_PER_ROUND && ok; ++op) {
+            ok = run_op(&table, ref, &seed);
+        }
+        ok = ok && verify_table(&table, ref);
+        if (!ok) {
+            fprintf(stderr, "generic_table_check: mismatch in round %d.\n",
+                    round);
+        }
+    }
+
+    // Drain through remove so block unlinking is covered as well.
+    for (size_t id = 0; id < SKU_COUNT && ok; ++id) {
+        if (ref->present[id]) {
+            sku_t sku;
+            make_sku(&sku, id);
+            ok = stock_table_remove(&table, &sku, NULL) == GENERIC_TABLE_OK;
+            ref->present[id] = false;
+            ref->count--;
+        }
+    }
+    ok = ok && table.head == NULL && verify_table(&table, ref);
+
+    stock_table_destroy(&table);
+    free(ref);
+    if (!ok) {
+        fprintf(stderr, "generic_table_check: FAILED\n");
+        return EXIT_FAILURE;
+    }
+    printf("generic_table_check: %d operations on %d colliding keys OK\n",
+           CHECK_ROUNDS * CHECK_OPS_PER_ROUND, SKU_COUNT);
+    return EXIT_SUCCESS;
+}
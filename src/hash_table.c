@@ -5,88 +5,91 @@
 #include <stdlib.h>
 #include <string.h>
 
-static hash_record_t *create_record(uint32_t hash, const char *name,
-                                    uint32_t salary) {
-    hash_record_t *record = (hash_record_t *)malloc(sizeof(hash_record_t));
-    if (!record) {
-        return NULL;
-    }
-
-    record->hash = hash;
-    strncpy(record->name, name, MAX_NAME_LEN - 1);
-    record->name[MAX_NAME_LEN - 1] = '\0';
-    record->salary = salary;
-    record->next = NULL;
-    return record;
+#include "salary_index.h"
+
+static inline uint32_t employee_key_hash(const uint32_t *key) {
+    return *key;  // keys are already Jenkins hashes
+}
+
+static inline int employee_key_compare(const uint32_t *a, const uint32_t *b) {
+    return (*a > *b) - (*a < *b);
+}
+
+GENERIC_TABLE_DEFINE(employee_table, uint32_t, employee_t, employee_key_hash,
+                     employee_key_compare)
+
+static void copy_record(record_snapshot_t *dest,
+                        const employee_table_entry_t *record) {
+    dest->hash = record->key;
+    memcpy(dest->name, record->value.name, MAX_NAME_LEN);
+    dest->salary = record->value.salary;
 }
 
 void hash_table_init(hash_table_t *table) {
-    table->head = NULL;
+    employee_table_init(&table->records);
+    table->salary_sum = 0;
+    table->salary_index = NULL;
 }
 
 void hash_table_destroy(hash_table_t *table) {
-    hash_record_t *current = table->head;
-    while (current) {
-        hash_record_t *next = current->next;
-        free(current);
-        current = next;
-    }
-    table->head = NULL;
+    employee_table_destroy(&table->records);
+    table->salary_sum = 0;
+    salary_index_destroy(table->salary_index);
+    table->salary_index = NULL;
 }
 
 table_status_t hash_table_insert(hash_table_t *table, uint32_t hash,
                                  const char *name, uint32_t salary) {
-    hash_record_t *prev = NULL;
-    hash_record_t *current = table->head;
-
-    while (current && current->hash < hash) {
-        prev = current;
-        current = current->next;
-    }
+    employee_t employee;
+    strncpy(employee.name, name, MAX_NAME_LEN - 1);
+    employee.name[MAX_NAME_LEN - 1] = '\0';
+    employee.salary = salary;
 
-    if (current && current->hash == hash) {
+    employee_table_entry_t *record = NULL;
+    generic_table_status_t status =
+        employee_table_insert(&table->records, &hash, &employee, &record);
+    if (status == GENERIC_TABLE_DUPLICATE) {
         return TABLE_DUPLICATE;
     }
-
-    hash_record_t *record = create_record(hash, name, salary);
-    if (!record) {
+    if (status != GENERIC_TABLE_OK) {
         return TABLE_NOT_FOUND;  // reuse error for allocation failure
     }
 
-    record->next = current;
-    if (prev) {
-        prev->next = record;
-    } else {
-        table->head = record;
+    if (table->salary_index) {
+        record_snapshot_t entry;
+        copy_record(&entry, record);
+        if (!salary_index_add(table->salary_index, &entry)) {
+            employee_table_remove(&table->records, &hash, NULL);
+            return TABLE_NOT_FOUND;
+        }
     }
 
+    table->salary_sum += salary;
     return TABLE_OK;
 }
 
 table_status_t hash_table_update(hash_table_t *table, uint32_t hash,
                                  uint32_t salary, record_snapshot_t *before,
                                  record_snapshot_t *after) {
-    hash_record_t *current = table->head;
-    while (current && current->hash < hash) {
-        current = current->next;
-    }
-
-    if (!current || current->hash != hash) {
+    employee_table_entry_t *current =
+        employee_table_find(&table->records, &hash);
+    if (!current) {
         return TABLE_NOT_FOUND;
     }
 
     if (before) {
-        before->hash = current->hash;
-        strncpy(before->name, current->name, MAX_NAME_LEN);
-        before->salary = current->salary;
+        copy_record(before, current);
     }
 
-    current->salary = salary;
+    if (table->salary_index) {
+        salary_index_move(table->salary_index, hash, current->value.salary,
+                          salary);
+    }
+    table->salary_sum = table->salary_sum - current->value.salary + salary;
+    current->value.salary = salary;
 
     if (after) {
-        after->hash = current->hash;
-        strncpy(after->name, current->name, MAX_NAME_LEN);
-        after->salary = current->salary;
+        copy_record(after, current);
     }
 
     return TABLE_OK;
@@ -94,49 +97,35 @@ table_status_t hash_table_update(hash_table_t *table, uint32_t hash,
 
 table_status_t hash_table_delete(hash_table_t *table, uint32_t hash,
                                  record_snapshot_t *removed) {
-    hash_record_t *prev = NULL;
-    hash_record_t *current = table->head;
-
-    while (current && current->hash < hash) {
-        prev = current;
-        current = current->next;
-    }
-
-    if (!current || current->hash != hash) {
+    employee_t employee;
+    if (employee_table_remove(&table->records, &hash, &employee) !=
+        GENERIC_TABLE_OK) {
         return TABLE_NOT_FOUND;
     }
 
-    if (prev) {
-        prev->next = current->next;
-    } else {
-        table->head = current->next;
-    }
-
     if (removed) {
-        removed->hash = current->hash;
-        strncpy(removed->name, current->name, MAX_NAME_LEN);
-        removed->salary = current->salary;
+        removed->hash = hash;
+        strncpy(removed->name, employee.name, MAX_NAME_LEN);
+        removed->salary = employee.salary;
     }
 
-    free(current);
+    if (table->salary_index) {
+        salary_index_remove(table->salary_index, hash, employee.salary);
+    }
+    table->salary_sum -= employee.salary;
     return TABLE_OK;
 }
 
 bool hash_table_find(const hash_table_t *table, uint32_t hash,
                      record_snapshot_t *result) {
-    hash_record_t *current = table->head;
-    while (current && current->hash < hash) {
-        current = current->next;
-    }
-
-    if (!current || current->hash != hash) {
+    const employee_table_entry_t *current =
+        employee_table_find(&table->records, &hash);
+    if (!current) {
         return false;
     }
 
     if (result) {
-        result->hash = current->hash;
-        strncpy(result->name, current->name, MAX_NAME_LEN);
-        result->salary = current->salary;
+        copy_record(result, current);
     }
 
     return true;
@@ -144,11 +133,100 @@ bool hash_table_find(const hash_table_t *table, uint32_t hash,
 
 size_t hash_table_snapshot(const hash_table_t *table,
                            record_snapshot_t **records_out) {
+    size_t count = table->records.count;
+    record_snapshot_t *records = NULL;
+    if (count > 0) {
+        records = (record_snapshot_t *)calloc(count, sizeof(record_snapshot_t));
+        if (!records) {
+            *records_out = NULL;
+            return SIZE_MAX;
+        }
+    }
+
+    employee_table_iter_t iter;
+    const employee_table_entry_t *current =
+        employee_table_first(&table->records, &iter);
+    for (size_t i = 0; i < count; ++i) {
+        copy_record(&records[i], current);
+        current = employee_table_next(&iter);
+    }
+
+    *records_out = records;
+    return count;
+}
+
+bool hash_table_enable_salary_index(hash_table_t *table) {
+    if (table->salary_index) {
+        return true;
+    }
+
+    salary_index_t *index = salary_index_create();
+    if (!index) {
+        return false;
+    }
+    employee_table_iter_t iter;
+    for (const employee_table_entry_t *current =
+             employee_table_first(&table->records, &iter);
+         current; current = employee_table_next(&iter)) {
+        record_snapshot_t entry;
+        copy_record(&entry, current);
+        if (!salary_index_add(index, &entry)) {
+            salary_index_destroy(index);
+            return false;
+        }
+    }
+
+    table->salary_index = index;
+    return true;
+}
+
+void hash_table_stats(const hash_table_t *table, table_stats_t *stats) {
+    stats->count = table->records.count;
+    stats->salary_sum = table->salary_sum;
+    stats->salary_min = 0;
+    stats->salary_max = 0;
+
+    if (table->salary_index) {
+        record_snapshot_t edge;
+        if (salary_index_min(table->salary_index, &edge)) {
+            stats->salary_min = edge.salary;
+        }
+        if (salary_index_max(table->salary_index, &edge)) {
+            stats->salary_max = edge.salary;
+        }
+        return;
+    }
+
+    employee_table_iter_t iter;
+    const employee_table_entry_t *current =
+        employee_table_first(&table->records, &iter);
+    if (current) {
+        stats->salary_min = stats->salary_max = current->value.salary;
+    }
+    for (; current; current = employee_table_next(&iter)) {
+        if (current->value.salary < stats->salary_min) {
+            stats->salary_min = current->value.salary;
+        }
+        if (current->value.salary > stats->salary_max) {
+            stats->salary_max = current->value.salary;
+        }
+    }
+}
+
+size_t hash_table_salary_range(const hash_table_t *table, uint32_t low,
+                               uint32_t high, record_snapshot_t **records_out) {
+    if (table->salary_index) {
+        return salary_index_range(table->salary_index, low, high, records_out);
+    }
+
     size_t count = 0;
-    hash_record_t *current = table->head;
-    while (current) {
-        count++;
-        current = current->next;
+    employee_table_iter_t iter;
+    for (const employee_table_entry_t *current =
+             employee_table_first(&table->records, &iter);
+         current; current = employee_table_next(&iter)) {
+        if (current->value.salary >= low && current->value.salary <= high) {
+            count++;
+        }
     }
 
     record_snapshot_t *records = NULL;
@@ -160,12 +238,17 @@ size_t hash_table_snapshot(const hash_table_t *table,
         }
     }
 
-    current = table->head;
-    for (size_t i = 0; i < count; ++i) {
-        records[i].hash = current->hash;
-        strncpy(records[i].name, current->name, MAX_NAME_LEN);
-        records[i].salary = current->salary;
-        current = current->next;
+    size_t i = 0;
+    for (const employee_table_entry_t *current =
+             employee_table_first(&table->records, &iter);
+         current && i < count; current = employee_table_next(&iter)) {
+        if (current->value.salary >= low && current->value.salary <= high) {
+            copy_record(&records[i++], current);
+        }
+    }
+    if (count > 1) {
+        qsort(records, count, sizeof(record_snapshot_t),
+              salary_index_compare);
     }
 
     *records_out = records;
@@ -0,0 +1,605 @@
+#include "hash_table.h"
+
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "salary_index.h"
+
+// Lock-free skiplist after Herlihy & Shavit. A node is logically deleted once
+// the low bit of its level-0 link is set; any traversal that meets a marked
+// link snips the node out of that level. Unlinked nodes are retired and freed
+// only after every operation that started before the unlink has finished.
+
+#define SKIPLIST_MAX_LEVEL 16
+#define LINK_MARK ((uintptr_t)1)
+#define SALARY_DELETED ((uint64_t)1 << 32)
+// Retired nodes are freed in batches once this many are waiting.
+#define RECLAIM_BATCH 64
+
+struct skiplist_node {
+    uint32_t hash;
+    int height;
+    // Salary in the low 32 bits, SALARY_DELETED once a delete has won.
+    _Atomic uint64_t salary;
+    // Bumped by the inserter when it stops linking and by the deleter when it
+    // has marked the node. Whoever comes second unlinks and retires it.
+    atomic_int link_users;
+    struct skiplist_node *retired_next;
+    char name[MAX_NAME_LEN];
+    _Atomic uintptr_t next[];
+};
+
+typedef struct skiplist_node skiplist_node_t;
+
+static _Thread_local uint64_t level_rng;
+
+static skiplist_node_t *link_target(uintptr_t link) {
+    return (skiplist_node_t *)(link & ~LINK_MARK);
+}
+
+static skiplist_node_t *create_node(uint32_t hash, const char *name,
+                                    uint32_t salary, int height) {
+    skiplist_node_t *node = (skiplist_node_t *)malloc(
+        sizeof(skiplist_node_t) + (size_t)height * sizeof(_Atomic uintptr_t));
+    if (!node) {
+        return NULL;
+    }
+
+    node->hash = hash;
+    node->height = height;
+    atomic_init(&node->salary, salary);
+    atomic_init(&node->link_users, 0);
+    node->retired_next = NULL;
+    strncpy(node->name, name, MAX_NAME_LEN - 1);
+    node->name[MAX_NAME_LEN - 1] = '\0';
+    for (int lvl = 0; lvl < height; ++lvl) {
+        atomic_init(&node->next[lvl], 0);
+    }
+    return node;
+}
+
+static int random_height(void) {
+    uint64_t x = level_rng;
+    if (x == 0) {
+        x = (uint64_t)(uintptr_t)&level_rng | 1u;
+    }
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    level_rng = x;
+
+    int height = 1;
+    while (height < SKIPLIST_MAX_LEVEL && (x & 3) == 0) {
+        height++;
+        x >>= 2;
+    }
+    return height;
+}
+
+static void copy_node(record_snapshot_t *dest, const skiplist_node_t *node,
+                      uint32_t salary) {
+    dest->hash = node->hash;
+    strncpy(dest->name, node->name, MAX_NAME_LEN);
+    dest->salary = salary;
+}
+
+// Readers and writers register in the current epoch's slot. The reclaimer
+// flips the epoch and waits for the old slot to empty before freeing.
+static unsigned guard_enter(hash_table_t *table) {
+    for (;;) {
+        unsigned epoch = atomic_load(&table->reclaim_epoch);
+        atomic_fetch_add(&table->active[epoch & 1], 1);
+        if (atomic_load(&table->reclaim_epoch) == epoch) {
+            return epoch;
+        }
+        atomic_fetch_sub(&table->active[epoch & 1], 1);
+    }
+}
+
+static void guard_exit(hash_table_t *table, unsigned epoch) {
+    atomic_fetch_sub(&table->active[epoch & 1], 1);
+}
+
+static void retire_node(hash_table_t *table, skiplist_node_t *node) {
+    skiplist_node_t *head = atomic_load(&table->retired);
+    do {
+        node->retired_next = head;
+    } while (!atomic_compare_exchange_weak(&table->retired, &head, node));
+    atomic_fetch_add(&table->retired_count, 1);
+}
+
+// Must be called outside a guard.
+static void maybe_reclaim(hash_table_t *table) {
+    if (atomic_load_explicit(&table->retired_count, memory_order_relaxed) <
+            RECLAIM_BATCH ||
+        pthread_mutex_trylock(&table->reclaim_mutex) != 0) {
+        return;
+    }
+
+    // Everything on the list was unlinked before this exchange, so only
+    // operations that entered before the epoch flip can still see it.
+    skiplist_node_t *batch = atomic_exchange(&table->retired, NULL);
+    unsigned epoch = atomic_fetch_add(&table->reclaim_epoch, 1);
+    while (atomic_load(&table->active[epoch & 1]) != 0) {
+        sched_yield();
+    }
+
+    size_t freed = 0;
+    while (batch) {
+        skiplist_node_t *next = batch->retired_next;
+        free(batch);
+        batch = next;
+        freed++;
+    }
+    atomic_fetch_sub(&table->retired_count, freed);
+    pthread_mutex_unlock(&table->reclaim_mutex);
+}
+
+// Fills preds/succs with the neighbours of `hash` on every level, snipping
+// marked nodes on the way. Returns true if an unmarked node with `hash` is
+// linked at level 0 (it is then succs[0]).
+static bool find(hash_table_t *table, uint32_t hash, skiplist_node_t **preds,
+                 skiplist_node_t **succs) {
+retry:;
+    skiplist_node_t *pred = table->head;
+    for (int lvl = SKIPLIST_MAX_LEVEL - 1; lvl >= 0; --lvl) {
+        skiplist_node_t *curr = link_target(atomic_load(&pred->next[lvl]));
+        while (curr) {
+            uintptr_t succ = atomic_load(&curr->next[lvl]);
+            if (succ & LINK_MARK) {
+                uintptr_t expected = (uintptr_t)curr;
+                if (!atomic_compare_exchange_strong(&pred->next[lvl], &expected,
+                                                    succ & ~LINK_MARK)) {
+                    goto retry;
+                }
+                curr = link_target(succ);
+                continue;
+            }
+            if (curr->hash >= hash) {
+                break;
+            }
+            pred = curr;
+            curr = link_target(succ);
+        }
+        preds[lvl] = pred;
+        succs[lvl] = curr;
+    }
+    return succs[0] && succs[0]->hash == hash;
+}
+
+// Read-only variant of find() that steps over marked nodes instead of
+// snipping them.
+static skiplist_node_t *lookup(hash_table_t *table, uint32_t hash) {
+    skiplist_node_t *pred = table->head;
+    skiplist_node_t *curr = NULL;
+    for (int lvl = SKIPLIST_MAX_LEVEL - 1; lvl >= 0; --lvl) {
+        curr = link_target(atomic_load(&pred->next[lvl]));
+        while (curr) {
+            uintptr_t succ = atomic_load(&curr->next[lvl]);
+            if (!(succ & LINK_MARK)) {
+                if (curr->hash >= hash) {
+                    break;
+                }
+                pred = curr;
+            }
+            curr = link_target(succ);
+        }
+    }
+    return curr && curr->hash == hash ? curr : NULL;
+}
+
+static void release_links(hash_table_t *table, skiplist_node_t *node) {
+    if (atomic_fetch_add(&node->link_users, 1) == 1) {
+        skiplist_node_t *preds[SKIPLIST_MAX_LEVEL];
+        skiplist_node_t *succs[SKIPLIST_MAX_LEVEL];
+        find(table, node->hash, preds, succs);
+        retire_node(table, node);
+    }
+}
+
+// Links levels 1..height-1 after the node went live at level 0. Gives up as
+// soon as a delete has marked the node.
+static void link_upper_levels(hash_table_t *table, skiplist_node_t *node,
+                              skiplist_node_t **preds,
+                              skiplist_node_t **succs) {
+    for (int lvl = 1; lvl < node->height; ++lvl) {
+        for (;;) {
+            uintptr_t link = atomic_load(&node->next[lvl]);
+            if ((link & LINK_MARK) ||
+                !atomic_compare_exchange_strong(&node->next[lvl], &link,
+                                                (uintptr_t)succs[lvl])) {
+                return;
+            }
+            uintptr_t expected = (uintptr_t)succs[lvl];
+            if (atomic_compare_exchange_strong(&preds[lvl]->next[lvl],
+                                               &expected, (uintptr_t)node)) {
+                break;
+            }
+            if (!find(table, node->hash, preds, succs) || succs[0] != node) {
+                return;
+            }
+        }
+    }
+}
+
+void hash_table_init(hash_table_t *table) {
+    table->head = create_node(0, "", 0, SKIPLIST_MAX_LEVEL);
+    atomic_init(&table->count, 0);
+    atomic_init(&table->salary_sum, 0);
+    table->salary_index = NULL;
+    pthread_mutex_init(&table->index_mutex, NULL);
+    atomic_init(&table->reclaim_epoch, 0);
+    atomic_init(&table->active[0], 0);
+    atomic_init(&table->active[1], 0);
+    atomic_init(&table->retired, NULL);
+    atomic_init(&table->retired_count, 0);
+    pthread_mutex_init(&table->reclaim_mutex, NULL);
+}
+
+void hash_table_destroy(hash_table_t *table) {
+    skiplist_node_t *current = table->head;
+    while (current) {
+        skiplist_node_t *next = link_target(atomic_load(&current->next[0]));
+        free(current);
+        current = next;
+    }
+    current = atomic_exchange(&table->retired, NULL);
+    while (current) {
+        skiplist_node_t *next = current->retired_next;
+        free(current);
+        current = next;
+    }
+    table->head = NULL;
+    atomic_store(&table->count, 0);
+    atomic_store(&table->salary_sum, 0);
+    atomic_store(&table->retired_count, 0);
+    salary_index_destroy(table->salary_index);
+    table->salary_index = NULL;
+    pthread_mutex_destroy(&table->index_mutex);
+    pthread_mutex_destroy(&table->reclaim_mutex);
+}
+
+table_status_t hash_table_insert(hash_table_t *table, uint32_t hash,
+                                 const char *name, uint32_t salary) {
+    if (!table->head) {
+        return TABLE_NOT_FOUND;  // reuse error for allocation failure
+    }
+    skiplist_node_t *node = create_node(hash, name, salary, random_height());
+    if (!node) {
+        return TABLE_NOT_FOUND;  // reuse error for allocation failure
+    }
+
+    bool indexed = table->salary_index != NULL;
+    if (indexed) {
+        pthread_mutex_lock(&table->index_mutex);
+    }
+    unsigned epoch = guard_enter(table);
+
+    skiplist_node_t *preds[SKIPLIST_MAX_LEVEL];
+    skiplist_node_t *succs[SKIPLIST_MAX_LEVEL];
+    table_status_t status = TABLE_OK;
+    if (indexed) {
+        record_snapshot_t entry;
+        copy_node(&entry, node, salary);
+        if (lookup(table, hash)) {
+            status = TABLE_DUPLICATE;
+        } else if (!salary_index_add(table->salary_index, &entry)) {
+            status = TABLE_NOT_FOUND;
+        }
+    }
+
+    while (status == TABLE_OK) {
+        if (find(table, hash, preds, succs)) {
+            status = TABLE_DUPLICATE;
+            break;
+        }
+        for (int lvl = 0; lvl < node->height; ++lvl) {
+            atomic_store_explicit(&node->next[lvl], (uintptr_t)succs[lvl],
+                                  memory_order_relaxed);
+        }
+        // Counted before the node is visible, so a racing delete never
+        // drives the totals below zero.
+        atomic_fetch_add(&table->count, 1);
+        atomic_fetch_add(&table->salary_sum, salary);
+        uintptr_t expected = (uintptr_t)succs[0];
+        if (atomic_compare_exchange_strong(&preds[0]->next[0], &expected,
+                                           (uintptr_t)node)) {
+            break;
+        }
+        atomic_fetch_sub(&table->count, 1);
+        atomic_fetch_sub(&table->salary_sum, salary);
+    }
+
+    if (status == TABLE_OK) {
+        link_upper_levels(table, node, preds, succs);
+        release_links(table, node);
+    }
+
+    guard_exit(table, epoch);
+    if (indexed) {
+        pthread_mutex_unlock(&table->index_mutex);
+    }
+    if (status != TABLE_OK) {
+        free(node);
+    }
+    maybe_reclaim(table);
+    return status;
+}
+
+table_status_t hash_table_update(hash_table_t *table, uint32_t hash,
+                                 uint32_t salary, record_snapshot_t *before,
+                                 record_snapshot_t *after) {
+    if (!table->head) {
+        return TABLE_NOT_FOUND;
+    }
+
+    bool indexed = table->salary_index != NULL;
+    if (indexed) {
+        pthread_mutex_lock(&table->index_mutex);
+    }
+    unsigned epoch = guard_enter(table);
+
+    table_status_t status = TABLE_NOT_FOUND;
+    skiplist_node_t *node = lookup(table, hash);
+    uint64_t state = node ? atomic_load(&node->salary) : SALARY_DELETED;
+    while (!(state & SALARY_DELETED)) {
+        if (atomic_compare_exchange_weak(&node->salary, &state, salary)) {
+            status = TABLE_OK;
+            break;
+        }
+    }
+
+    if (status == TABLE_OK) {
+        uint32_t old_salary = (uint32_t)state;
+        // Modular arithmetic, so a raise and a cut both come out right.
+        atomic_fetch_add(&table->salary_sum,
+                         (uint64_t)salary - (uint64_t)old_salary);
+        if (indexed) {
+            salary_index_move(table->salary_index, hash, old_salary, salary);
+        }
+        if (before) {
+            copy_node(before, node, old_salary);
+        }
+        if (after) {
+            copy_node(after, node, salary);
+        }
+    }
+
+    guard_exit(table, epoch);
+    if (indexed) {
+        pthread_mutex_unlock(&table->index_mutex);
+    }
+    return status;
+}
+
+table_status_t hash_table_delete(hash_table_t *table, uint32_t hash,
+                                 record_snapshot_t *removed) {
+    if (!table->head) {
+        return TABLE_NOT_FOUND;
+    }
+
+    bool indexed = table->salary_index != NULL;
+    if (indexed) {
+        pthread_mutex_lock(&table->index_mutex);
+    }
+    unsigned epoch = guard_enter(table);
+
+    skiplist_node_t *preds[SKIPLIST_MAX_LEVEL];
+    skiplist_node_t *succs[SKIPLIST_MAX_LEVEL];
+    table_status_t status = TABLE_NOT_FOUND;
+    if (find(table, hash, preds, succs)) {
+        skiplist_node_t *node = succs[0];
+        for (int lvl = node->height - 1; lvl > 0; --lvl) {
+            atomic_fetch_or(&node->next[lvl], LINK_MARK);
+        }
+        // Marking level 0 is the linearization point; only one delete wins.
+        uintptr_t link = atomic_load(&node->next[0]);
+        while (!(link & LINK_MARK)) {
+            if (atomic_compare_exchange_weak(&node->next[0], &link,
+                                             link | LINK_MARK)) {
+                status = TABLE_OK;
+                break;
+            }
+        }
+
+        if (status == TABLE_OK) {
+            uint32_t salary =
+                (uint32_t)atomic_fetch_or(&node->salary, SALARY_DELETED);
+            atomic_fetch_sub(&table->count, 1);
+            atomic_fetch_sub(&table->salary_sum, salary);
+            if (indexed) {
+                salary_index_remove(table->salary_index, hash, salary);
+            }
+            if (removed) {
+                copy_node(removed, node, salary);
+            }
+            release_links(table, node);
+        }
+    }
+
+    guard_exit(table, epoch);
+    if (indexed) {
+        pthread_mutex_unlock(&table->index_mutex);
+    }
+    maybe_reclaim(table);
+    return status;
+}
+
+bool hash_table_find(const hash_table_t *table, uint32_t hash,
+                     record_snapshot_t *result) {
+    // The guard counters are the only state a reader writes.
+    hash_table_t *shared = (hash_table_t *)table;
+    if (!shared->head) {
+        return false;
+    }
+
+    unsigned epoch = guard_enter(shared);
+    skiplist_node_t *node = lookup(shared, hash);
+    uint64_t state = node ? atomic_load(&node->salary) : SALARY_DELETED;
+    bool found = !(state & SALARY_DELETED);
+    if (found && result) {
+        copy_node(result, node, (uint32_t)state);
+    }
+    guard_exit(shared, epoch);
+    return found;
+}
+
+size_t hash_table_snapshot(const hash_table_t *table,
+                           record_snapshot_t **records_out) {
+    hash_table_t *shared = (hash_table_t *)table;
+    *records_out = NULL;
+    if (!shared->head) {
+        return 0;
+    }
+
+    size_t capacity = atomic_load(&shared->count) + 16;
+    record_snapshot_t *records =
+        (record_snapshot_t *)malloc(capacity * sizeof(record_snapshot_t));
+    if (!records) {
+        return SIZE_MAX;
+    }
+
+    // Level 0 is already in hash order; nodes deleted mid-walk are skipped.
+    size_t count = 0;
+    unsigned epoch = guard_enter(shared);
+    skiplist_node_t *current = link_target(atomic_load(&shared->head->next[0]));
+    while (current) {
+        uintptr_t link = atomic_load(&current->next[0]);
+        uint64_t state = atomic_load(&current->salary);
+        if (!(link & LINK_MARK) && !(state & SALARY_DELETED)) {
+            if (count == capacity) {
+                record_snapshot_t *grown = (record_snapshot_t *)realloc(
+                    records, 2 * capacity * sizeof(record_snapshot_t));
+                if (!grown) {
+                    guard_exit(shared, epoch);
+                    free(records);
+                    return SIZE_MAX;
+                }
+                records = grown;
+                capacity *= 2;
+            }
+            copy_node(&records[count++], current, (uint32_t)state);
+        }
+        current = link_target(link);
+    }
+    guard_exit(shared, epoch);
+
+    if (count == 0) {
+        free(records);
+        records = NULL;
+    }
+    *records_out = records;
+    return count;
+}
+
+bool hash_table_enable_salary_index(hash_table_t *table) {
+    if (table->salary_index) {
+        return true;
+    }
+
+    salary_index_t *index = salary_index_create();
+    if (!index) {
+        return false;
+    }
+    record_snapshot_t *records = NULL;
+    size_t count = hash_table_snapshot(table, &records);
+    if (count == SIZE_MAX) {
+        salary_index_destroy(index);
+        return false;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (!salary_index_add(index, &records[i])) {
+            free(records);
+            salary_index_destroy(index);
+            return false;
+        }
+    }
+    free(records);
+
+    table->salary_index = index;
+    return true;
+}
+
+void hash_table_stats(const hash_table_t *table, table_stats_t *stats) {
+    hash_table_t *shared = (hash_table_t *)table;
+    stats->salary_min = 0;
+    stats->salary_max = 0;
+
+    if (shared->salary_index) {
+        pthread_mutex_lock(&shared->index_mutex);
+        stats->count = atomic_load(&shared->count);
+        stats->salary_sum = atomic_load(&shared->salary_sum);
+        record_snapshot_t edge;
+        if (salary_index_min(shared->salary_index, &edge)) {
+            stats->salary_min = edge.salary;
+        }
+        if (salary_index_max(shared->salary_index, &edge)) {
+            stats->salary_max = edge.salary;
+        }
+        pthread_mutex_unlock(&shared->index_mutex);
+        return;
+    }
+
+    stats->count = atomic_load(&shared->count);
+    stats->salary_sum = atomic_load(&shared->salary_sum);
+    if (!shared->head) {
+        return;
+    }
+
+    bool seen = false;
+    unsigned epoch = guard_enter(shared);
+    skiplist_node_t *current = link_target(atomic_load(&shared->head->next[0]));
+    while (current) {
+        uintptr_t link = atomic_load(&current->next[0]);
+        uint64_t state = atomic_load(&current->salary);
+        if (!(link & LINK_MARK) && !(state & SALARY_DELETED)) {
+            uint32_t salary = (uint32_t)state;
+            if (!seen || salary < stats->salary_min) {
+                stats->salary_min = salary;
+            }
+            if (!seen || salary > stats->salary_max) {
+                stats->salary_max = salary;
+            }
+            seen = true;
+        }
+        current = link_target(link);
+    }
+    guard_exit(shared, epoch);
+}
+
+size_t hash_table_salary_range(const hash_table_t *table, uint32_t low,
+                               uint32_t high, record_snapshot_t **records_out) {
+    hash_table_t *shared = (hash_table_t *)table;
+    if (shared->salary_index) {
+        pthread_mutex_lock(&shared->index_mutex);
+        size_t count = salary_index_range(shared->salary_index, low, high,
+                                          records_out);
+        pthread_mutex_unlock(&shared->index_mutex);
+        return count;
+    }
+
+    record_snapshot_t *records = NULL;
+    size_t total = hash_table_snapshot(table, &records);
+    if (total == SIZE_MAX) {
+        *records_out = NULL;
+        return SIZE_MAX;
+    }
+
+    size_t count = 0;
+    for (size_t i = 0; i < total; ++i) {
+        if (records[i].salary >= low && records[i].salary <= high) {
+            records[count++] = records[i];
+        }
+    }
+    if (count == 0) {
+        free(records);
+        records = NULL;
+    } else if (count > 1) {
+        qsort(records, count, sizeof(record_snapshot_t),
+              salary_index_compare);
+    }
+
+    *records_out = records;
+    return count;
+}
@@ -0,0 +1,15 @@
+#include "jenkins_hash.h"
+
+uint32_t jenkins_hash(const char *key) {
+    uint32_t hash = 0;
+    while (*key) {
+        hash += (unsigned char)(*key);
+        hash += (hash << 10);
+        hash ^= (hash >> 6);
+        key++;
+    }
+    hash += (hash << 3);
+    hash ^= (hash >> 11);
+    hash += (hash << 15);
+    return hash;
+}
@@ -0,0 +1,90 @@
+#define _GNU_SOURCE
+
+#include "node_topology.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NODE_SYSFS "/sys/devices/system/node"
+
+// Reads a sysfs list such as "0-3,8-11" and calls `visit` for each entry.
+static bool read_id_list(const char *path, void (*visit)(int, void *),
+                         void *ctx) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return false;
+    }
+
+    char line[4096];
+    bool ok = fgets(line, sizeof(line), file) != NULL;
+    fclose(file);
+    if (!ok) {
+        return false;
+    }
+
+    char *save = NULL;
+    for (char *range = strtok_r(line, ",\n", &save); range;
+         range = strtok_r(NULL, ",\n", &save)) {
+        char *dash = strchr(range, '-');
+        int first = atoi(range);
+        int last = dash ? atoi(dash + 1) : first;
+        for (int id = first; id <= last; ++id) {
+            visit(id, ctx);
+        }
+    }
+    return true;
+}
+
+static void collect_node(int id, void *ctx) {
+    node_topology_t *topology = (node_topology_t *)ctx;
+    int *grown = (int *)realloc(topology->nodes,
+                                (topology->count + 1) * sizeof(int));
+    if (!grown) {
+        return;
+    }
+    topology->nodes = grown;
+    topology->nodes[topology->count++] = id;
+}
+
+static void collect_cpu(int id, void *ctx) {
+    if (id >= 0 && id < CPU_SETSIZE) {
+        CPU_SET(id, (cpu_set_t *)ctx);
+    }
+}
+
+int node_topology_load(node_topology_t *topology) {
+    topology->nodes = NULL;
+    topology->count = 0;
+    read_id_list(NODE_SYSFS "/online", collect_node, topology);
+    if (topology->count == 0) {
+        topology->nodes = (int *)malloc(sizeof(int));
+        if (!topology->nodes) {
+            return -1;
+        }
+        topology->nodes[0] = 0;
+        topology->count = 1;
+    }
+    return 0;
+}
+
+void node_topology_free(node_topology_t *topology) {
+    free(topology->nodes);
+    topology->nodes = NULL;
+    topology->count = 0;
+}
+
+int node_topology_pin(int node) {
+    char path[128];
+    snprintf(path, sizeof(path), NODE_SYSFS "/node%d/cpulist", node);
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    if (!read_id_list(path, collect_cpu, &cpus) || CPU_COUNT(&cpus) == 0) {
+        return -1;
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+}
@@ -0,0 +1,220 @@
+#include "salary_index.h"
+
+#include <stdlib.h>
+
+#define SALARY_INDEX_MAX_LEVEL 32
+
+typedef struct salary_node {
+    record_snapshot_t record;
+    struct salary_node *prev;  // level 0 only, keeps the maximum O(1)
+    int height;
+    struct salary_node *next[];
+} salary_node_t;
+
+struct salary_index {
+    salary_node_t *head;
+    salary_node_t *tail;
+    int level;
+    uint64_t rng;
+};
+
+static salary_node_t *create_node(int height) {
+    salary_node_t *node = (salary_node_t *)calloc(
+        1, sizeof(salary_node_t) + (size_t)height * sizeof(salary_node_t *));
+    if (node) {
+        node->height = height;
+    }
+    return node;
+}
+
+static bool key_less(uint32_t salary_a, uint32_t hash_a, uint32_t salary_b,
+                     uint32_t hash_b) {
+    return salary_a < salary_b || (salary_a == salary_b && hash_a < hash_b);
+}
+
+int salary_index_compare(const void *a, const void *b) {
+    const record_snapshot_t *x = (const record_snapshot_t *)a;
+    const record_snapshot_t *y = (const record_snapshot_t *)b;
+    if (key_less(x->salary, x->hash, y->salary, y->hash)) {
+        return -1;
+    }
+    return key_less(y->salary, y->hash, x->salary, x->hash);
+}
+
+static int random_height(salary_index_t *index) {
+    uint64_t x = index->rng;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    index->rng = x;
+
+    int height = 1;
+    while (height < SALARY_INDEX_MAX_LEVEL && (x & 3) == 0) {
+        height++;
+        x >>= 2;
+    }
+    return height;
+}
+
+// Fills `update` with the last node before (salary, hash) on every level.
+static void find_preds(const salary_index_t *index, uint32_t salary,
+                       uint32_t hash, salary_node_t **update) {
+    salary_node_t *x = index->head;
+    for (int lvl = index->level - 1; lvl >= 0; --lvl) {
+        while (x->next[lvl] &&
+               key_less(x->next[lvl]->record.salary, x->next[lvl]->record.hash,
+                        salary, hash)) {
+            x = x->next[lvl];
+        }
+        update[lvl] = x;
+    }
+}
+
+static void link_node(salary_index_t *index, salary_node_t *node) {
+    salary_node_t *update[SALARY_INDEX_MAX_LEVEL];
+    find_preds(index, node->record.salary, node->record.hash, update);
+    for (int lvl = index->level; lvl < node->height; ++lvl) {
+        update[lvl] = index->head;
+    }
+    if (node->height > index->level) {
+        index->level = node->height;
+    }
+
+    for (int lvl = 0; lvl < node->height; ++lvl) {
+        node->next[lvl] = update[lvl]->next[lvl];
+        update[lvl]->next[lvl] = node;
+    }
+    node->prev = update[0] == index->head ? NULL : update[0];
+    if (node->next[0]) {
+        node->next[0]->prev = node;
+    } else {
+        index->tail = node;
+    }
+}
+
+static salary_node_t *unlink_node(salary_index_t *index, uint32_t hash,
+                                  uint32_t salary) {
+    salary_node_t *update[SALARY_INDEX_MAX_LEVEL];
+    find_preds(index, salary, hash, update);
+    salary_node_t *node = update[0]->next[0];
+    if (!node || node->record.hash != hash || node->record.salary != salary) {
+        return NULL;
+    }
+
+    for (int lvl = 0; lvl < node->height; ++lvl) {
+        if (update[lvl]->next[lvl] == node) {
+            update[lvl]->next[lvl] = node->next[lvl];
+        }
+    }
+    if (node->next[0]) {
+        node->next[0]->prev = node->prev;
+    } else {
+        index->tail = node->prev;
+    }
+    while (index->level > 1 && !index->head->next[index->level - 1]) {
+        index->level--;
+    }
+    return node;
+}
+
+salary_index_t *salary_index_create(void) {
+    salary_index_t *index = (salary_index_t *)malloc(sizeof(salary_index_t));
+    if (!index) {
+        return NULL;
+    }
+    index->head = create_node(SALARY_INDEX_MAX_LEVEL);
+    if (!index->head) {
+        free(index);
+        return NULL;
+    }
+    index->tail = NULL;
+    index->level = 1;
+    index->rng = 0x2545F4914F6CDD1Dull;
+    return index;
+}
+
+void salary_index_destroy(salary_index_t *index) {
+    if (!index) {
+        return;
+    }
+    salary_node_t *current = index->head;
+    while (current) {
+        salary_node_t *next = current->next[0];
+        free(current);
+        current = next;
+    }
+    free(index);
+}
+
+bool salary_index_add(salary_index_t *index, const record_snapshot_t *record) {
+    salary_node_t *node = create_node(random_height(index));
+    if (!node) {
+        return false;
+    }
+    node->record = *record;
+    link_node(index, node);
+    return true;
+}
+
+void salary_index_remove(salary_index_t *index, uint32_t hash,
+                         uint32_t salary) {
+    free(unlink_node(index, hash, salary));
+}
+
+void salary_index_move(salary_index_t *index, uint32_t hash,
+                       uint32_t old_salary, uint32_t new_salary) {
+    salary_node_t *node = unlink_node(index, hash, old_salary);
+    if (!node) {
+        return;
+    }
+    node->record.salary = new_salary;
+    link_node(index, node);
+}
+
+bool salary_index_min(const salary_index_t *index, record_snapshot_t *result) {
+    salary_node_t *first = index->head->next[0];
+    if (!first) {
+        return false;
+    }
+    *result = first->record;
+    return true;
+}
+
+bool salary_index_max(const salary_index_t *index, record_snapshot_t *result) {
+    if (!index->tail) {
+        return false;
+    }
+    *result = index->tail->record;
+    return true;
+}
+
+size_t salary_index_range(const salary_index_t *index, uint32_t low,
+                          uint32_t high, record_snapshot_t **records_out) {
+    salary_node_t *update[SALARY_INDEX_MAX_LEVEL];
+    find_preds(index, low, 0, update);
+    salary_node_t *first = update[0]->next[0];
+
+    size_t count = 0;
+    for (salary_node_t *x = first; x && x->record.salary <= high;
+         x = x->next[0]) {
+        count++;
+    }
+
+    record_snapshot_t *records = NULL;
+    if (count > 0) {
+        records = (record_snapshot_t *)malloc(count * sizeof(record_snapshot_t));
+        if (!records) {
+            *records_out = NULL;
+            return SIZE_MAX;
+        }
+    }
+
+    salary_node_t *x = first;
+    for (size_t i = 0; i < count; ++i) {
+        records[i] = x->record;
+        x = x->next[0];
+    }
+
+    *records_out = records;
+    return count;
+}
@@ -0,0 +1,676 @@
+#define _GNU_SOURCE
+
+#include "server.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+#define MAX_EVENTS 64
+#define READ_CHUNK 65536
+// A client that sends this much without a newline is dropped.
+#define MAX_PENDING_INPUT (1u << 20)
+// New batches are held back while this much output is still unsent.
+#define OUTPUT_HIGH_WATER (4u << 20)
+
+typedef struct connection {
+    int fd;
+    char *in;
+    size_t in_len;
+    size_t in_cap;
+    char *out;
+    size_t out_len;
+    size_t out_off;
+    size_t out_cap;
+    // Complete lines handed to a worker, and the text it produced.
+    char *job;
+    size_t job_len;
+    char *result;
+    size_t result_len;
+    // At most one batch per connection runs at a time, which keeps the
+    // responses to pipelined requests in order.
+    bool busy;
+    bool peer_closed;
+    uint32_t interest;
+    struct connection *next_job;
+    struct connection *prev;
+    struct connection *next;
+} connection_t;
+
+typedef struct {
+    app_context_t *app;
+    bool tcp;
+    int epoll_fd;
+    int listen_fd;
+    int event_fd;
+    int signal_fd;
+    pthread_mutex_t queue_mutex;
+    pthread_cond_t queue_cond;
+    connection_t *queue_head;
+    connection_t *queue_tail;
+    bool stopping;
+    pthread_mutex_t done_mutex;
+    connection_t *done_head;
+    connection_t *connections;
+    connection_t *graveyard;
+} server_t;
+
+static int open_listener(server_t *srv, const server_config_t *config);
+static void *server_worker(void *arg);
+static void run_job(server_t *srv, connection_t *conn);
+static void accept_clients(server_t *srv);
+static void handle_connection(server_t *srv, connection_t *conn,
+                              uint32_t events);
+static void collect_done(server_t *srv);
+static void conn_progress(server_t *srv, connection_t *conn);
+static void read_input(server_t *srv, connection_t *conn);
+static bool flush_output(server_t *srv, connection_t *conn);
+static void dispatch(server_t *srv, connection_t *conn);
+static bool append_output(connection_t *conn, const char *data, size_t len);
+static void update_interest(server_t *srv, connection_t *conn);
+static void close_connection(server_t *srv, connection_t *conn);
+static void retire_connection(server_t *srv, connection_t *conn);
+static void free_graveyard(server_t *srv);
+
+int server_run(app_context_t *app, const server_config_t *config) {
+    server_t srv;
+    memset(&srv, 0, sizeof(srv));
+    srv.app = app;
+    srv.epoll_fd = srv.listen_fd = srv.event_fd = srv.signal_fd = -1;
+
+    // Block the shutdown signals before any worker exists so that only the
+    // signalfd ever sees them.
+    sigset_t mask;
+    sigset_t old_mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &mask, &old_mask);
+
+    int rc = -1;
+    pthread_t *workers = NULL;
+    int started = 0;
+
+    srv.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    srv.event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    srv.signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (srv.epoll_fd < 0 || srv.event_fd < 0 || srv.signal_fd < 0) {
+        fprintf(stderr, "Unable to set up event loop: %s\n", strerror(errno));
+        goto cleanup;
+    }
+    if (open_listener(&srv, config) != 0) {
+        goto cleanup;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = &srv.listen_fd;
+    epoll_ctl(srv.epoll_fd, EPOLL_CTL_ADD, srv.listen_fd, &ev);
+    ev.data.ptr = &srv.event_fd;
+    epoll_ctl(srv.epoll_fd, EPOLL_CTL_ADD, srv.event_fd, &ev);
+    ev.data.ptr = &srv.signal_fd;
+    epoll_ctl(srv.epoll_fd, EPOLL_CTL_ADD, srv.signal_fd, &ev);
+
+    pthread_mutex_init(&srv.queue_mutex, NULL);
+    pthread_cond_init(&srv.queue_cond, NULL);
+    pthread_mutex_init(&srv.done_mutex, NULL);
+
+    workers = (pthread_t *)calloc((size_t)config->workers, sizeof(pthread_t));
+    if (!workers) {
+        fprintf(stderr, "Failed to allocate worker threads.\n");
+        goto stop;
+    }
+    for (; started < config->workers; ++started) {
+        int err = pthread_create(&workers[started], NULL, server_worker, &srv);
+        if (err != 0) {
+            fprintf(stderr, "Failed to create worker %d (error %d).\n",
+                    started, err);
+            goto stop;
+        }
+    }
+
+    if (config->unix_path) {
+        logger_log(&app->logger, "SERVER LISTENING ON %s", config->unix_path);
+        fprintf(stderr, "Listening on %s\n", config->unix_path);
+    } else {
+        logger_log(&app->logger, "SERVER LISTENING ON 127.0.0.1:%d",
+                   config->tcp_port);
+        fprintf(stderr, "Listening on 127.0.0.1:%d\n", config->tcp_port);
+    }
+
+    struct epoll_event events[MAX_EVENTS];
+    bool running = true;
+    while (running) {
+        int n = epoll_wait(srv.epoll_fd, events, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "epoll_wait failed: %s\n", strerror(errno));
+            goto stop;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            void *source = events[i].data.ptr;
+            if (source == &srv.listen_fd) {
+                accept_clients(&srv);
+            } else if (source == &srv.event_fd) {
+                collect_done(&srv);
+            } else if (source == &srv.signal_fd) {
+                struct signalfd_siginfo info;
+                while (read(srv.signal_fd, &info, sizeof(info)) > 0) {
+                }
+                running = false;
+            } else {
+                handle_connection(&srv, (connection_t *)source,
+                                  events[i].events);
+            }
+        }
+        free_graveyard(&srv);
+    }
+    rc = 0;
+
+stop:
+    pthread_mutex_lock(&srv.queue_mutex);
+    srv.stopping = true;
+    pthread_cond_broadcast(&srv.queue_cond);
+    pthread_mutex_unlock(&srv.queue_mutex);
+    for (int i = 0; i < started; ++i) {
+        pthread_join(workers[i], NULL);
+    }
+    free(workers);
+
+    // Deliver whatever the workers finished, then drop every client.
+    collect_done(&srv);
+    while (srv.connections) {
+        connection_t *conn = srv.connections;
+        if (conn->fd >= 0) {
+            flush_output(&srv, conn);
+        }
+        close_connection(&srv, conn);
+        retire_connection(&srv, conn);
+    }
+    free_graveyard(&srv);
+
+    pthread_mutex_destroy(&srv.queue_mutex);
+    pthread_cond_destroy(&srv.queue_cond);
+    pthread_mutex_destroy(&srv.done_mutex);
+    logger_log(&app->logger, "SERVER STOPPED");
+
+cleanup:
+    if (srv.listen_fd >= 0) {
+        close(srv.listen_fd);
+        if (config->unix_path) {
+            unlink(config->unix_path);
+        }
+    }
+    if (srv.signal_fd >= 0) {
+        close(srv.signal_fd);
+    }
+    if (srv.event_fd >= 0) {
+        close(srv.event_fd);
+    }
+    if (srv.epoll_fd >= 0) {
+        close(srv.epoll_fd);
+    }
+    pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+    return rc;
+}
+
+static int open_listener(server_t *srv, const server_config_t *config) {
+    int fd;
+    if (config->unix_path) {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (strlen(config->unix_path) >= sizeof(addr.sun_path)) {
+            fprintf(stderr, "Socket path %s is too long.\n", config->unix_path);
+            return -1;
+        }
+        strcpy(addr.sun_path, config->unix_path);
+
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            fprintf(stderr, "Unable to create socket: %s\n", strerror(errno));
+            return -1;
+        }
+        unlink(config->unix_path);
+        if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+            fprintf(stderr, "Unable to bind %s: %s\n", config->unix_path,
+                    strerror(errno));
+            close(fd);
+            return -1;
+        }
+    } else {
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t)config->tcp_port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            fprintf(stderr, "Unable to create socket: %s\n", strerror(errno));
+            return -1;
+        }
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+            fprintf(stderr, "Unable to bind port %d: %s\n", config->tcp_port,
+                    strerror(errno));
+            close(fd);
+            return -1;
+        }
+        srv->tcp = true;
+    }
+
+    if (listen(fd, SOMAXCONN) != 0) {
+        fprintf(stderr, "Unable to listen: %s\n", strerror(errno));
+        close(fd);
+        if (config->unix_path) {
+            unlink(config->unix_path);
+        }
+        return -1;
+    }
+    srv->listen_fd = fd;
+    return 0;
+}
+
+static void *server_worker(void *arg) {
+    server_t *srv = (server_t *)arg;
+    trace_thread_name("WORKER");
+    for (;;) {
+        uint64_t wait_start = trace_now();
+        pthread_mutex_lock(&srv->queue_mutex);
+        while (!srv->queue_head && !srv->stopping) {
+            pthread_cond_wait(&srv->queue_cond, &srv->queue_mutex);
+        }
+        connection_t *conn = srv->queue_head;
+        if (!conn) {
+            pthread_mutex_unlock(&srv->queue_mutex);
+            break;
+        }
+        srv->queue_head = conn->next_job;
+        if (!srv->queue_head) {
+            srv->queue_tail = NULL;
+        }
+        pthread_mutex_unlock(&srv->queue_mutex);
+        trace_span(TRACE_SCHED_WAIT, wait_start, NULL);
+
+        run_job(srv, conn);
+
+        pthread_mutex_lock(&srv->done_mutex);
+        conn->next_job = srv->done_head;
+        srv->done_head = conn;
+        pthread_mutex_unlock(&srv->done_mutex);
+
+        uint64_t one = 1;
+        ssize_t written = write(srv->event_fd, &one, sizeof(one));
+        (void)written;
+    }
+    return NULL;
+}
+
+static void run_job(server_t *srv, connection_t *conn) {
+    char *result = NULL;
+    size_t result_len = 0;
+    FILE *out = open_memstream(&result, &result_len);
+    if (!out) {
+        conn->result = NULL;
+        conn->result_len = 0;
+        return;
+    }
+
+    char *cursor = conn->job;
+    char *end = conn->job + conn->job_len;
+    while (cursor < end) {
+        char *newline = (char *)memchr(cursor, '\n', (size_t)(end - cursor));
+        *newline = '\0';
+        char *line = trim(cursor);
+        cursor = newline + 1;
+        if (*line == '\0') {
+            continue;
+        }
+
+        command_t cmd;
+        if (strlen(line) >= MAX_LINE_LEN ||
+            parse_command_line(line, &cmd) != 0) {
+            fputs("Invalid command.\n", out);
+        } else {
+            execute_command(srv->app, &cmd, out, false);
+        }
+        fputc('\n', out);
+    }
+
+    fclose(out);
+    conn->result = result;
+    conn->result_len = result_len;
+}
+
+static void accept_clients(server_t *srv) {
+    for (;;) {
+        int fd = accept4(srv->listen_fd, NULL, NULL,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                fprintf(stderr, "accept failed: %s\n", strerror(errno));
+            }
+            return;
+        }
+
+        if (srv->tcp) {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+
+        connection_t *conn = (connection_t *)calloc(1, sizeof(connection_t));
+        if (!conn) {
+            close(fd);
+            continue;
+        }
+        conn->fd = fd;
+        conn->interest = EPOLLIN;
+
+        struct epoll_event ev;
+        ev.events = conn->interest;
+        ev.data.ptr = conn;
+        if (epoll_ctl(srv->epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            close(fd);
+            free(conn);
+            continue;
+        }
+
+        conn->next = srv->connections;
+        if (srv->connections) {
+            srv->connections->prev = conn;
+        }
+        srv->connections = conn;
+    }
+}
+
+static void handle_connection(server_t *srv, connection_t *conn,
+                              uint32_t events) {
+    if (conn->fd < 0) {
+        return;
+    }
+    if (events & EPOLLERR) {
+        close_connection(srv, conn);
+        if (!conn->busy) {
+            retire_connection(srv, conn);
+        }
+        return;
+    }
+    if (events & (EPOLLIN | EPOLLHUP)) {
+        read_input(srv, conn);
+        if (conn->fd < 0) {
+            if (!conn->busy) {
+                retire_connection(srv, conn);
+            }
+            return;
+        }
+    }
+    conn_progress(srv, conn);
+}
+
+static void collect_done(server_t *srv) {
+    uint64_t ignored;
+    ssize_t drained = read(srv->event_fd, &ignored, sizeof(ignored));
+    (void)drained;
+
+    pthread_mutex_lock(&srv->done_mutex);
+    connection_t *list = srv->done_head;
+    srv->done_head = NULL;
+    pthread_mutex_unlock(&srv->done_mutex);
+
+    while (list) {
+        connection_t *conn = list;
+        list = conn->next_job;
+        conn->next_job = NULL;
+        conn->busy = false;
+        free(conn->job);
+        conn->job = NULL;
+        conn->job_len = 0;
+
+        if (conn->fd >= 0 &&
+            (!conn->result ||
+             !append_output(conn, conn->result, conn->result_len))) {
+            close_connection(srv, conn);
+        }
+        free(conn->result);
+        conn->result = NULL;
+        conn->result_len = 0;
+
+        if (conn->fd < 0) {
+            retire_connection(srv, conn);
+        } else {
+            conn_progress(srv, conn);
+        }
+    }
+}
+
+static void conn_progress(server_t *srv, connection_t *conn) {
+    if (!flush_output(srv, conn)) {
+        if (!conn->busy) {
+            retire_connection(srv, conn);
+        }
+        return;
+    }
+    dispatch(srv, conn);
+    if (conn->fd < 0) {
+        retire_connection(srv, conn);
+        return;
+    }
+    if (conn->peer_closed && !conn->busy && conn->out_len == 0) {
+        close_connection(srv, conn);
+        retire_connection(srv, conn);
+        return;
+    }
+    update_interest(srv, conn);
+}
+
+static void read_input(server_t *srv, connection_t *conn) {
+    while (!conn->peer_closed && conn->in_len < MAX_PENDING_INPUT) {
+        if (conn->in_cap - conn->in_len < READ_CHUNK) {
+            size_t cap = conn->in_len + READ_CHUNK;
+            char *grown = (char *)realloc(conn->in, cap);
+            if (!grown) {
+                close_connection(srv, conn);
+                return;
+            }
+            conn->in = grown;
+            conn->in_cap = cap;
+        }
+
+        ssize_t n = read(conn->fd, conn->in + conn->in_len,
+                         conn->in_cap - conn->in_len);
+        if (n > 0) {
+            conn->in_len += (size_t)n;
+        } else if (n == 0) {
+            conn->peer_closed = true;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return;
+        } else {
+            close_connection(srv, conn);
+            return;
+        }
+    }
+}
+
+static bool flush_output(server_t *srv, connection_t *conn) {
+    if (conn->fd < 0) {
+        return false;
+    }
+    while (conn->out_off < conn->out_len) {
+        ssize_t n = send(conn->fd, conn->out + conn->out_off,
+                         conn->out_len - conn->out_off, MSG_NOSIGNAL);
+        if (n > 0) {
+            conn->out_off += (size_t)n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        } else {
+            close_connection(srv, conn);
+            return false;
+        }
+    }
+    conn->out_off = conn->out_len = 0;
+    return true;
+}
+
+static void dispatch(server_t *srv, connection_t *conn) {
+    if (conn->busy || conn->in_len == 0 ||
+        conn->out_len - conn->out_off > OUTPUT_HIGH_WATER) {
+        return;
+    }
+
+    // Whatever is left once the client stops sending is its last line.
+    if (conn->peer_closed && conn->in[conn->in_len - 1] != '\n') {
+        if (conn->in_len == conn->in_cap) {
+            char *grown = (char *)realloc(conn->in, conn->in_cap + 1);
+            if (!grown) {
+                close_connection(srv, conn);
+                return;
+            }
+            conn->in = grown;
+            conn->in_cap++;
+        }
+        conn->in[conn->in_len++] = '\n';
+    }
+
+    size_t batch = conn->in_len;
+    while (batch > 0 && conn->in[batch - 1] != '\n') {
+        batch--;
+    }
+    if (batch == 0) {
+        if (conn->in_len >= MAX_PENDING_INPUT) {
+            close_connection(srv, conn);
+        }
+        return;
+    }
+
+    char *job = (char *)malloc(batch);
+    if (!job) {
+        close_connection(srv, conn);
+        return;
+    }
+    memcpy(job, conn->in, batch);
+    memmove(conn->in, conn->in + batch, conn->in_len - batch);
+    conn->in_len -= batch;
+
+    conn->job = job;
+    conn->job_len = batch;
+    conn->busy = true;
+    conn->next_job = NULL;
+
+    pthread_mutex_lock(&srv->queue_mutex);
+    if (srv->queue_tail) {
+        srv->queue_tail->next_job = conn;
+    } else {
+        srv->queue_head = conn;
+    }
+    srv->queue_tail = conn;
+    pthread_cond_signal(&srv->queue_cond);
+    pthread_mutex_unlock(&srv->queue_mutex);
+}
+
+static bool append_output(connection_t *conn, const char *data, size_t len) {
+    if (conn->out_off > 0) {
+        memmove(conn->out, conn->out + conn->out_off,
+                conn->out_len - conn->out_off);
+        conn->out_len -= conn->out_off;
+        conn->out_off = 0;
+    }
+    if (conn->out_cap - conn->out_len < len) {
+        size_t cap = conn->out_cap ? conn->out_cap : READ_CHUNK;
+        while (cap - conn->out_len < len) {
+            cap *= 2;
+        }
+        char *grown = (char *)realloc(conn->out, cap);
+        if (!grown) {
+            return false;
+        }
+        conn->out = grown;
+        conn->out_cap = cap;
+    }
+    memcpy(conn->out + conn->out_len, data, len);
+    conn->out_len += len;
+    return true;
+}
+
+static void update_interest(server_t *srv, connection_t *conn) {
+    uint32_t interest = 0;
+    if (!conn->peer_closed && conn->in_len < MAX_PENDING_INPUT) {
+        interest |= EPOLLIN;
+    }
+    if (conn->out_off < conn->out_len) {
+        interest |= EPOLLOUT;
+    }
+    if (interest == conn->interest) {
+        return;
+    }
+
+    struct epoll_event ev;
+    ev.events = interest;
+    ev.data.ptr = conn;
+    epoll_ctl(srv->epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev);
+    conn->interest = interest;
+}
+
+// Closes the socket. The connection itself lives on until its running batch
+// (if any) comes back from the workers.
+static void close_connection(server_t *srv, connection_t *conn) {
+    if (conn->fd < 0) {
+        return;
+    }
+    epoll_ctl(srv->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    conn->fd = -1;
+}
+
+static void retire_connection(server_t *srv, connection_t *conn) {
+    if (conn->prev) {
+        conn->prev->next = conn->next;
+    } else {
+        srv->connections = conn->next;
+    }
+    if (conn->next) {
+        conn->next->prev = conn->prev;
+    }
+    // Freed after the current batch of events, which may still mention it.
+    conn->next = srv->graveyard;
+    conn->prev = NULL;
+    srv->graveyard = conn;
+}
+
+static void free_graveyard(server_t *srv) {
+    while (srv->graveyard) {
+        connection_t *conn = srv->graveyard;
+        srv->graveyard = conn->next;
+        free(conn->in);
+        free(conn->out);
+        free(conn->job);
+        free(conn->result);
+        free(conn);
+    }
+}
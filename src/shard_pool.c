@@ -0,0 +1,201 @@
+#include "shard_pool.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "jenkins_hash.h"
+#include "node_topology.h"
+#include "trace.h"
+
+typedef struct {
+    app_context_t *app;
+    size_t index;
+    int node;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    pthread_cond_t drained;
+    const command_t *queue[SHARD_QUEUE_CAPACITY];
+    size_t head;
+    size_t count;
+    // Commands queued or still executing.
+    size_t in_flight;
+    bool stopping;
+} shard_worker_t;
+
+static void *shard_worker_main(void *arg);
+static void enqueue(shard_worker_t *worker, const command_t *cmd);
+static void wait_drained(shard_worker_t *workers, size_t count);
+static bool spans_shards(const command_t *cmd);
+static int compare_priority(const void *a, const void *b);
+
+int shard_pool_run(app_context_t *app, command_t *commands, size_t count) {
+    size_t shard_count = app->shard_count;
+    const command_t **order =
+        (const command_t **)malloc(count * sizeof(command_t *));
+    shard_worker_t *workers =
+        (shard_worker_t *)calloc(shard_count, sizeof(shard_worker_t));
+    node_topology_t topology;
+    if (!order || !workers || node_topology_load(&topology) != 0) {
+        fprintf(stderr, "Failed to allocate shard workers.\n");
+        free(order);
+        free(workers);
+        return -1;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        order[i] = &commands[i];
+    }
+    qsort(order, count, sizeof(command_t *), compare_priority);
+
+    size_t started = 0;
+    for (; started < shard_count; ++started) {
+        shard_worker_t *worker = &workers[started];
+        worker->app = app;
+        worker->index = started;
+        worker->node = topology.nodes[started % topology.count];
+        // Moving the shard to the worker's node counts as in-flight work,
+        // so gathers wait for it like for any queued command.
+        worker->in_flight = 1;
+        pthread_mutex_init(&worker->mutex, NULL);
+        pthread_cond_init(&worker->not_empty, NULL);
+        pthread_cond_init(&worker->not_full, NULL);
+        pthread_cond_init(&worker->drained, NULL);
+        int rc = pthread_create(&worker->thread, NULL, shard_worker_main,
+                                worker);
+        if (rc != 0) {
+            fprintf(stderr, "Failed to create shard worker %zu (error %d).\n",
+                    started, rc);
+            break;
+        }
+    }
+    node_topology_free(&topology);
+
+    int result = 0;
+    if (started == shard_count) {
+        for (size_t i = 0; i < count; ++i) {
+            const command_t *cmd = order[i];
+            if (spans_shards(cmd)) {
+                uint64_t wait_start = trace_now();
+                wait_drained(workers, shard_count);
+                trace_span(TRACE_SCHED_WAIT, wait_start, "drain shards");
+                execute_command(app, cmd, stdout, false);
+            } else {
+                enqueue(&workers[jenkins_hash(cmd->name) % shard_count], cmd);
+            }
+        }
+        wait_drained(workers, shard_count);
+    } else {
+        result = -1;
+    }
+
+    for (size_t i = 0; i < started; ++i) {
+        pthread_mutex_lock(&workers[i].mutex);
+        workers[i].stopping = true;
+        pthread_cond_signal(&workers[i].not_empty);
+        pthread_mutex_unlock(&workers[i].mutex);
+    }
+    for (size_t i = 0; i < started; ++i) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    for (size_t i = 0; i <= started && i < shard_count; ++i) {
+        pthread_mutex_destroy(&workers[i].mutex);
+        pthread_cond_destroy(&workers[i].not_empty);
+        pthread_cond_destroy(&workers[i].not_full);
+        pthread_cond_destroy(&workers[i].drained);
+    }
+
+    free(workers);
+    free(order);
+    return result;
+}
+
+static void *shard_worker_main(void *arg) {
+    shard_worker_t *worker = (shard_worker_t *)arg;
+    app_context_t *app = worker->app;
+    trace_thread_name("SHARD %zu", worker->index);
+
+    if (node_topology_pin(worker->node) == 0) {
+        logger_log(&app->logger, "SHARD %zu PINNED TO NODE %d", worker->index,
+                   worker->node);
+        if (app_context_rehome_shard(app, worker->index) != 0) {
+            logger_log(&app->logger, "SHARD %zu NOT MOVED TO NODE %d",
+                       worker->index, worker->node);
+        }
+    } else {
+        logger_log(&app->logger, "SHARD %zu NOT PINNED (NODE %d)",
+                   worker->index, worker->node);
+    }
+    pthread_mutex_lock(&worker->mutex);
+    if (--worker->in_flight == 0) {
+        pthread_cond_broadcast(&worker->drained);
+    }
+    pthread_mutex_unlock(&worker->mutex);
+
+    for (;;) {
+        uint64_t wait_start = trace_now();
+        pthread_mutex_lock(&worker->mutex);
+        while (worker->count == 0 && !worker->stopping) {
+            pthread_cond_wait(&worker->not_empty, &worker->mutex);
+        }
+        if (worker->count == 0) {
+            pthread_mutex_unlock(&worker->mutex);
+            break;
+        }
+        const command_t *cmd = worker->queue[worker->head];
+        worker->head = (worker->head + 1) % SHARD_QUEUE_CAPACITY;
+        worker->count--;
+        pthread_cond_signal(&worker->not_full);
+        pthread_mutex_unlock(&worker->mutex);
+        trace_span(TRACE_SCHED_WAIT, wait_start, NULL);
+
+        execute_command(app, cmd, stdout, false);
+
+        pthread_mutex_lock(&worker->mutex);
+        if (--worker->in_flight == 0) {
+            pthread_cond_broadcast(&worker->drained);
+        }
+        pthread_mutex_unlock(&worker->mutex);
+    }
+    return NULL;
+}
+
+static void enqueue(shard_worker_t *worker, const command_t *cmd) {
+    pthread_mutex_lock(&worker->mutex);
+    while (worker->count == SHARD_QUEUE_CAPACITY) {
+        pthread_cond_wait(&worker->not_full, &worker->mutex);
+    }
+    size_t tail = (worker->head + worker->count) % SHARD_QUEUE_CAPACITY;
+    worker->queue[tail] = cmd;
+    worker->count++;
+    worker->in_flight++;
+    pthread_cond_signal(&worker->not_empty);
+    pthread_mutex_unlock(&worker->mutex);
+}
+
+static void wait_drained(shard_worker_t *workers, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        pthread_mutex_lock(&workers[i].mutex);
+        while (workers[i].in_flight > 0) {
+            pthread_cond_wait(&workers[i].drained, &workers[i].mutex);
+        }
+        pthread_mutex_unlock(&workers[i].mutex);
+    }
+}
+
+static bool spans_shards(const command_t *cmd) {
+    return cmd->type == CMD_PRINT || cmd->type == CMD_RANGE ||
+           cmd->type == CMD_STATS;
+}
+
+static int compare_priority(const void *a, const void *b) {
+    const command_t *x = *(const command_t *const *)a;
+    const command_t *y = *(const command_t *const *)b;
+    if (x->priority != y->priority) {
+        return (x->priority > y->priority) - (x->priority < y->priority);
+    }
+    return (x > y) - (x < y);
+}
@@ -0,0 +1,81 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jenkins_hash.h"
+#include "shm_table.h"
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s SEGMENT print\n"
+            "       %s SEGMENT search NAME\n"
+            "       %s SEGMENT unlink\n",
+            prog, prog, prog);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const char *segment = argv[1];
+    const char *command = argv[2];
+
+    if (strcmp(command, "unlink") == 0) {
+        if (shm_table_unlink(segment) != 0) {
+            fprintf(stderr, "Unable to unlink %s: %s\n", segment,
+                    strerror(errno));
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    shm_table_t *shm = shm_table_attach(segment);
+    if (!shm) {
+        fprintf(stderr, "Unable to attach to shared table %s.\n", segment);
+        return EXIT_FAILURE;
+    }
+
+    int rc = EXIT_SUCCESS;
+    shm_read_status_t status = SHM_READ_OK;
+    if (strcmp(command, "search") == 0 && argc == 4) {
+        record_snapshot_t found;
+        status = shm_table_find(shm, jenkins_hash(argv[3]), &found);
+        if (status == SHM_READ_OK) {
+            printf("Found: %u,%s,%u\n", found.hash, found.name, found.salary);
+        } else if (status == SHM_READ_NOT_FOUND) {
+            printf("%s not found.\n", argv[3]);
+        }
+    } else if (strcmp(command, "print") == 0) {
+        record_snapshot_t *records = NULL;
+        size_t count = 0;
+        status = shm_table_snapshot(shm, &records, &count);
+        if (status == SHM_READ_OK) {
+            printf("Current Database:\n");
+            for (size_t i = 0; i < count; ++i) {
+                printf("%u,%s,%u\n", records[i].hash, records[i].name,
+                       records[i].salary);
+            }
+            free(records);
+        }
+    } else {
+        usage(argv[0]);
+        rc = EXIT_FAILURE;
+    }
+
+    if (status == SHM_READ_BUSY) {
+        fprintf(stderr,
+                "Shared table %s is stuck mid-update; its writer may have "
+                "died.\n",
+                segment);
+        rc = EXIT_FAILURE;
+    } else if (status == SHM_READ_NO_MEMORY) {
+        fprintf(stderr, "Unable to allocate memory for snapshot.\n");
+        rc = EXIT_FAILURE;
+    }
+
+    shm_table_close(shm);
+    return rc;
+}
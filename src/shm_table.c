@@ -0,0 +1,499 @@
+#include "shm_table.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cache_line.h"
+
+#define SHM_TABLE_MAGIC 0x43484153u  // "CHAS"
+#define SHM_TABLE_VERSION 3u
+// How long readers wait for the writer to finish an update. Updates touch
+// a handful of slots, so only a writer that died mid-update gets near it.
+#define SHM_READ_TIMEOUT_NS 1000000000ull
+// Regions start after the header, each on its own cache line.
+#define SHM_REGION_OFFSET CACHE_LINE_SIZE
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t region_count;
+    uint32_t reserved;
+    uint64_t capacity;     // records across all regions
+    uint64_t region_size;  // bytes, a multiple of CACHE_LINE_SIZE
+} shm_header_t;
+
+// One cache line: the record plus whether the slot holds one.
+typedef struct {
+    uint32_t used;
+    record_snapshot_t record;
+} shm_slot_t;
+
+// Linear probing keyed by hash, at most half full, so a write touches a few
+// slots instead of shifting a sorted array.
+typedef struct {
+    // Odd while the writer is modifying the slots.
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t seq;
+    _Atomic uint64_t count;
+    uint64_t capacity;   // records
+    uint64_t slot_mask;  // slot count - 1, a power of two
+    _Alignas(CACHE_LINE_SIZE) shm_slot_t slots[];
+} shm_region_t;
+
+struct shm_table {
+    shm_header_t *header;
+    size_t map_size;
+    bool writable;
+    // Writer only, one per region.
+    pthread_mutex_t *write_mutexes;
+};
+
+static size_t slot_count_for(size_t capacity) {
+    size_t slots = 2;
+    while (slots < 2 * capacity) {
+        slots *= 2;
+    }
+    return slots;
+}
+
+static size_t region_size_for(size_t slots) {
+    size_t size = sizeof(shm_region_t) + slots * sizeof(shm_slot_t);
+    return (size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+}
+
+static shm_region_t *region_at(const shm_table_t *shm, size_t index) {
+    return (shm_region_t *)((char *)shm->header + SHM_REGION_OFFSET +
+                            index * shm->header->region_size);
+}
+
+static size_t region_index(const shm_table_t *shm, uint32_t hash) {
+    return hash % shm->header->region_count;
+}
+
+// The region already took `hash % regions`; the quotient spreads the rest.
+static size_t home_slot(const shm_table_t *shm, const shm_region_t *region,
+                        uint32_t hash) {
+    return (hash / shm->header->region_count) & region->slot_mask;
+}
+
+static void write_begin(shm_region_t *region) {
+    uint64_t seq = atomic_load_explicit(&region->seq, memory_order_relaxed);
+    atomic_store_explicit(&region->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+static void write_end(shm_region_t *region) {
+    uint64_t seq = atomic_load_explicit(&region->seq, memory_order_relaxed);
+    atomic_store_explicit(&region->seq, seq + 1, memory_order_release);
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Waits for an even sequence number. Returns false if the writer stays
+// mid-update past SHM_READ_TIMEOUT_NS; one that died there never finishes.
+static bool read_begin(const shm_region_t *region, uint64_t *seq_out) {
+    uint64_t deadline = 0;
+    for (;;) {
+        uint64_t seq =
+            atomic_load_explicit(&region->seq, memory_order_acquire);
+        if (!(seq & 1u)) {
+            *seq_out = seq;
+            return true;
+        }
+        uint64_t now = now_ns();
+        if (deadline == 0) {
+            deadline = now + SHM_READ_TIMEOUT_NS;
+        } else if (now >= deadline) {
+            return false;
+        }
+        sched_yield();
+    }
+}
+
+static bool read_retry(const shm_region_t *region, uint64_t seq) {
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&region->seq, memory_order_relaxed) != seq;
+}
+
+// Finds `hash` in its probe sequence. Returns true with *slot_out at the
+// record, or false with *slot_out at the empty slot that ends the sequence
+// (SIZE_MAX if a reader saw no empty slot, which only a torn read can).
+static bool probe(const shm_table_t *shm, const shm_region_t *region,
+                  uint32_t hash, size_t *slot_out) {
+    size_t slot = home_slot(shm, region, hash);
+    for (uint64_t step = 0; step <= region->slot_mask; ++step) {
+        const shm_slot_t *entry = &region->slots[slot];
+        if (!entry->used) {
+            *slot_out = slot;
+            return false;
+        }
+        if (entry->record.hash == hash) {
+            *slot_out = slot;
+            return true;
+        }
+        slot = (slot + 1) & region->slot_mask;
+    }
+    *slot_out = SIZE_MAX;
+    return false;
+}
+
+static void destroy_mutexes(pthread_mutex_t *mutexes, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        pthread_mutex_destroy(&mutexes[i]);
+    }
+    free(mutexes);
+}
+
+shm_table_t *shm_table_create(const char *name, size_t capacity,
+                              size_t regions) {
+    if (capacity == 0 || regions == 0 || regions > UINT32_MAX) {
+        return NULL;
+    }
+
+    shm_table_t *shm = (shm_table_t *)calloc(1, sizeof(shm_table_t));
+    if (!shm) {
+        return NULL;
+    }
+    shm->write_mutexes =
+        (pthread_mutex_t *)calloc(regions, sizeof(pthread_mutex_t));
+    if (!shm->write_mutexes) {
+        free(shm);
+        return NULL;
+    }
+
+    size_t region_capacity = (capacity + regions - 1) / regions;
+    size_t slots = slot_count_for(region_capacity);
+    size_t region_size = region_size_for(slots);
+
+    shm_unlink(name);
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        free(shm->write_mutexes);
+        free(shm);
+        return NULL;
+    }
+
+    shm->map_size = SHM_REGION_OFFSET + regions * region_size;
+    if (ftruncate(fd, (off_t)shm->map_size) != 0) {
+        close(fd);
+        shm_unlink(name);
+        free(shm->write_mutexes);
+        free(shm);
+        return NULL;
+    }
+
+    void *addr = mmap(NULL, shm->map_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                      fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        shm_unlink(name);
+        free(shm->write_mutexes);
+        free(shm);
+        return NULL;
+    }
+
+    // A fresh segment is zero-filled, so every slot starts out unused.
+    shm->header = (shm_header_t *)addr;
+    shm->header->version = SHM_TABLE_VERSION;
+    shm->header->region_count = (uint32_t)regions;
+    shm->header->capacity = capacity;
+    shm->header->region_size = region_size;
+    for (size_t i = 0; i < regions; ++i) {
+        shm_region_t *region = region_at(shm, i);
+        atomic_store_explicit(&region->seq, 0, memory_order_relaxed);
+        atomic_store_explicit(&region->count, 0, memory_order_relaxed);
+        region->capacity = region_capacity;
+        region->slot_mask = slots - 1;
+        pthread_mutex_init(&shm->write_mutexes[i], NULL);
+    }
+    atomic_thread_fence(memory_order_release);
+    shm->header->magic = SHM_TABLE_MAGIC;
+    shm->writable = true;
+    return shm;
+}
+
+// Rejects segments whose geometry does not fit the mapping, so readers can
+// trust region_size and every slot_mask afterwards.
+static bool layout_valid(const shm_table_t *shm, size_t size) {
+    const shm_header_t *header = shm->header;
+    if (header->magic != SHM_TABLE_MAGIC ||
+        header->version != SHM_TABLE_VERSION || header->region_count == 0 ||
+        header->region_size < sizeof(shm_region_t) ||
+        header->region_size % CACHE_LINE_SIZE != 0 ||
+        header->region_size > (size - SHM_REGION_OFFSET) /
+                                  header->region_count) {
+        return false;
+    }
+    for (size_t i = 0; i < header->region_count; ++i) {
+        const shm_region_t *region = region_at(shm, i);
+        uint64_t slots = region->slot_mask + 1;
+        if (slots == 0 || (slots & region->slot_mask) != 0 ||
+            slots > (header->region_size - sizeof(shm_region_t)) /
+                        sizeof(shm_slot_t)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+shm_table_t *shm_table_attach(const char *name) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < SHM_REGION_OFFSET) {
+        close(fd);
+        return NULL;
+    }
+
+    void *addr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        return NULL;
+    }
+
+    shm_table_t *shm = (shm_table_t *)calloc(1, sizeof(shm_table_t));
+    if (!shm) {
+        munmap(addr, (size_t)st.st_size);
+        return NULL;
+    }
+    shm->header = (shm_header_t *)addr;
+    shm->map_size = (size_t)st.st_size;
+    shm->writable = false;
+    if (!layout_valid(shm, shm->map_size)) {
+        munmap(addr, shm->map_size);
+        free(shm);
+        return NULL;
+    }
+    return shm;
+}
+
+void shm_table_close(shm_table_t *shm) {
+    if (!shm) {
+        return;
+    }
+    if (shm->writable) {
+        destroy_mutexes(shm->write_mutexes, shm->header->region_count);
+    }
+    munmap(shm->header, shm->map_size);
+    free(shm);
+}
+
+int shm_table_unlink(const char *name) {
+    return shm_unlink(name);
+}
+
+size_t shm_table_capacity(const shm_table_t *shm) {
+    return (size_t)shm->header->capacity;
+}
+
+table_status_t shm_table_insert(shm_table_t *shm, uint32_t hash,
+                                const char *name, uint32_t salary) {
+    size_t index = region_index(shm, hash);
+    shm_region_t *region = region_at(shm, index);
+    pthread_mutex_lock(&shm->write_mutexes[index]);
+    size_t slot;
+    if (probe(shm, region, hash, &slot)) {
+        pthread_mutex_unlock(&shm->write_mutexes[index]);
+        return TABLE_DUPLICATE;
+    }
+    uint64_t count = atomic_load_explicit(&region->count, memory_order_relaxed);
+    if (count == region->capacity) {
+        pthread_mutex_unlock(&shm->write_mutexes[index]);
+        return TABLE_FULL;
+    }
+
+    write_begin(region);
+    shm_slot_t *entry = &region->slots[slot];
+    entry->record.hash = hash;
+    strncpy(entry->record.name, name, MAX_NAME_LEN - 1);
+    entry->record.name[MAX_NAME_LEN - 1] = '\0';
+    entry->record.salary = salary;
+    entry->used = 1;
+    atomic_store_explicit(&region->count, count + 1, memory_order_relaxed);
+    write_end(region);
+
+    pthread_mutex_unlock(&shm->write_mutexes[index]);
+    return TABLE_OK;
+}
+
+table_status_t shm_table_update(shm_table_t *shm, uint32_t hash,
+                                uint32_t salary) {
+    size_t index = region_index(shm, hash);
+    shm_region_t *region = region_at(shm, index);
+    pthread_mutex_lock(&shm->write_mutexes[index]);
+    size_t slot;
+    if (!probe(shm, region, hash, &slot)) {
+        pthread_mutex_unlock(&shm->write_mutexes[index]);
+        return TABLE_NOT_FOUND;
+    }
+
+    write_begin(region);
+    region->slots[slot].record.salary = salary;
+    write_end(region);
+
+    pthread_mutex_unlock(&shm->write_mutexes[index]);
+    return TABLE_OK;
+}
+
+// Slot `slot` lies cyclically in (from, to].
+static bool slot_between(size_t from, size_t slot, size_t to) {
+    return from <= to ? from < slot && slot <= to : from < slot || slot <= to;
+}
+
+table_status_t shm_table_delete(shm_table_t *shm, uint32_t hash) {
+    size_t index = region_index(shm, hash);
+    shm_region_t *region = region_at(shm, index);
+    pthread_mutex_lock(&shm->write_mutexes[index]);
+    size_t hole;
+    if (!probe(shm, region, hash, &hole)) {
+        pthread_mutex_unlock(&shm->write_mutexes[index]);
+        return TABLE_NOT_FOUND;
+    }
+
+    // Backward-shift deletion: pull later records of the probe run into
+    // the hole unless that would move them before their home slot.
+    write_begin(region);
+    size_t next = hole;
+    for (;;) {
+        next = (next + 1) & region->slot_mask;
+        if (!region->slots[next].used) {
+            break;
+        }
+        size_t home = home_slot(shm, region, region->slots[next].record.hash);
+        if (slot_between(hole, home, next)) {
+            continue;
+        }
+        region->slots[hole] = region->slots[next];
+        hole = next;
+    }
+    region->slots[hole].used = 0;
+    uint64_t count = atomic_load_explicit(&region->count, memory_order_relaxed);
+    atomic_store_explicit(&region->count, count - 1, memory_order_relaxed);
+    write_end(region);
+
+    pthread_mutex_unlock(&shm->write_mutexes[index]);
+    return TABLE_OK;
+}
+
+shm_read_status_t shm_table_find(const shm_table_t *shm, uint32_t hash,
+                                 record_snapshot_t *result) {
+    const shm_region_t *region = region_at(shm, region_index(shm, hash));
+    record_snapshot_t copy;
+    bool found;
+    uint64_t seq;
+
+    do {
+        if (!read_begin(region, &seq)) {
+            return SHM_READ_BUSY;
+        }
+        size_t slot;
+        found = probe(shm, region, hash, &slot);
+        if (found) {
+            memcpy(&copy, &region->slots[slot].record, sizeof(copy));
+        }
+    } while (read_retry(region, seq));
+
+    if (!found) {
+        return SHM_READ_NOT_FOUND;
+    }
+    if (result) {
+        *result = copy;
+        result->name[MAX_NAME_LEN - 1] = '\0';
+    }
+    return SHM_READ_OK;
+}
+
+static int compare_hash(const void *a, const void *b) {
+    uint32_t x = ((const record_snapshot_t *)a)->hash;
+    uint32_t y = ((const record_snapshot_t *)b)->hash;
+    return (x > y) - (x < y);
+}
+
+// Appends the used slots of `region`, copied in one read section, to
+// (*records)[*count...], growing the array as needed.
+static shm_read_status_t copy_region(const shm_region_t *region,
+                                     record_snapshot_t **records,
+                                     size_t *allocated, size_t *count) {
+    for (;;) {
+        uint64_t seq;
+        if (!read_begin(region, &seq)) {
+            return SHM_READ_BUSY;
+        }
+        size_t region_count = (size_t)atomic_load_explicit(
+            &region->count, memory_order_relaxed);
+        if (region_count > region->capacity) {
+            region_count = (size_t)region->capacity;  // torn; retried below
+        }
+        if (*count + region_count > *allocated) {
+            size_t grown_size = *count + region_count;
+            record_snapshot_t *grown = (record_snapshot_t *)realloc(
+                *records, grown_size * sizeof(record_snapshot_t));
+            if (!grown) {
+                return SHM_READ_NO_MEMORY;
+            }
+            *records = grown;
+            *allocated = grown_size;
+            // The copy below must come from one consistent read section.
+            continue;
+        }
+        size_t copied = 0;
+        for (uint64_t slot = 0;
+             slot <= region->slot_mask && copied < region_count; ++slot) {
+            if (region->slots[slot].used) {
+                memcpy(&(*records)[*count + copied],
+                       &region->slots[slot].record,
+                       sizeof(record_snapshot_t));
+                copied++;
+            }
+        }
+        if (!read_retry(region, seq)) {
+            *count += copied;
+            return SHM_READ_OK;
+        }
+    }
+}
+
+shm_read_status_t shm_table_snapshot(const shm_table_t *shm,
+                                     record_snapshot_t **records_out,
+                                     size_t *count_out) {
+    record_snapshot_t *records = NULL;
+    size_t allocated = 0;
+    size_t count = 0;
+
+    *records_out = NULL;
+    *count_out = 0;
+    for (size_t i = 0; i < shm->header->region_count; ++i) {
+        shm_read_status_t status =
+            copy_region(region_at(shm, i), &records, &allocated, &count);
+        if (status != SHM_READ_OK) {
+            free(records);
+            return status;
+        }
+    }
+
+    if (count == 0) {
+        free(records);
+        return SHM_READ_OK;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        records[i].name[MAX_NAME_LEN - 1] = '\0';
+    }
+    qsort(records, count, sizeof(record_snapshot_t), compare_hash);
+    *records_out = records;
+    *count_out = count;
+    return SHM_READ_OK;
+}
@@ -0,0 +1,241 @@
+#include "trace.h"
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Batch mode runs one thread per command, so buffers start small.
+#define TRACE_INITIAL_EVENTS 8
+#define TRACE_INITIAL_HELD 4
+#define TRACE_NAME_LEN 32
+
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+    const char *detail;
+    trace_kind_t kind;
+} trace_event_t;
+
+typedef struct trace_buffer {
+    uint32_t tid;
+    char name[TRACE_NAME_LEN];
+    trace_event_t *events;
+    size_t count;
+    size_t capacity;
+    // Start times of the locks currently held; nests at most shard_count
+    // deep, allocated on the first acquisition.
+    uint64_t *held;
+    size_t held_capacity;
+    size_t held_depth;
+    struct trace_buffer *next;
+} trace_buffer_t;
+
+static const char *const kind_names[] = {
+    [TRACE_SCHED_WAIT] = "scheduler wait",
+    [TRACE_LOCK_WAIT] = "lock wait",
+    [TRACE_LOCK_HOLD] = "lock hold",
+    [TRACE_COMMAND] = "command"
+};
+
+static struct {
+    bool enabled;
+    FILE *file;
+    uint64_t origin;
+    pthread_mutex_t mutex;
+    trace_buffer_t *buffers;
+    uint32_t next_tid;
+} tracer = {
+    .enabled = false,
+    .file = NULL,
+    .origin = 0,
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .buffers = NULL,
+    .next_tid = 1
+};
+
+static _Thread_local trace_buffer_t *local_buffer;
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static trace_buffer_t *thread_buffer(void) {
+    if (local_buffer) {
+        return local_buffer;
+    }
+
+    trace_buffer_t *buffer = (trace_buffer_t *)calloc(1, sizeof(*buffer));
+    if (!buffer) {
+        return NULL;
+    }
+    pthread_mutex_lock(&tracer.mutex);
+    buffer->tid = tracer.next_tid++;
+    buffer->next = tracer.buffers;
+    tracer.buffers = buffer;
+    pthread_mutex_unlock(&tracer.mutex);
+
+    local_buffer = buffer;
+    return buffer;
+}
+
+static void append_event(trace_buffer_t *buffer, trace_kind_t kind,
+                         uint64_t start, uint64_t end, const char *detail) {
+    if (buffer->count == buffer->capacity) {
+        size_t capacity =
+            buffer->capacity ? buffer->capacity * 2 : TRACE_INITIAL_EVENTS;
+        trace_event_t *grown = (trace_event_t *)realloc(
+            buffer->events, capacity * sizeof(trace_event_t));
+        if (!grown) {
+            return;
+        }
+        buffer->events = grown;
+        buffer->capacity = capacity;
+    }
+    trace_event_t *event = &buffer->events[buffer->count++];
+    event->start = start;
+    event->end = end;
+    event->detail = detail;
+    event->kind = kind;
+}
+
+int trace_open(const char *path) {
+    tracer.file = fopen(path, "w");
+    if (!tracer.file) {
+        return -1;
+    }
+    tracer.origin = monotonic_ns();
+    tracer.enabled = true;
+    return 0;
+}
+
+// Timestamps are microseconds since trace_open, as the format expects.
+static void write_time(FILE *file, uint64_t ns) {
+    fprintf(file, "%llu.%03llu", (unsigned long long)(ns / 1000),
+            (unsigned long long)(ns % 1000));
+}
+
+void trace_close(void) {
+    if (!tracer.enabled) {
+        return;
+    }
+    tracer.enabled = false;
+
+    FILE *file = tracer.file;
+    bool first = true;
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", file);
+    for (trace_buffer_t *buffer = tracer.buffers; buffer;
+         buffer = buffer->next) {
+        if (buffer->name[0]) {
+            fprintf(file,
+                    "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                    "\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                    first ? "" : ",\n", buffer->tid, buffer->name);
+            first = false;
+        }
+        for (size_t i = 0; i < buffer->count; ++i) {
+            const trace_event_t *event = &buffer->events[i];
+            uint64_t start =
+                event->start > tracer.origin ? event->start - tracer.origin : 0;
+            uint64_t duration =
+                event->end > event->start ? event->end - event->start : 0;
+            fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                          "\"ts\":",
+                    first ? "" : ",\n", kind_names[event->kind], buffer->tid);
+            write_time(file, start);
+            fputs(",\"dur\":", file);
+            write_time(file, duration);
+            if (event->detail) {
+                fprintf(file, ",\"args\":{\"detail\":\"%s\"}", event->detail);
+            }
+            fputc('}', file);
+            first = false;
+        }
+    }
+    fputs("\n]}\n", file);
+    fclose(file);
+    tracer.file = NULL;
+
+    trace_buffer_t *buffer = tracer.buffers;
+    while (buffer) {
+        trace_buffer_t *next = buffer->next;
+        free(buffer->events);
+        free(buffer->held);
+        free(buffer);
+        buffer = next;
+    }
+    tracer.buffers = NULL;
+}
+
+uint64_t trace_now(void) {
+    return tracer.enabled ? monotonic_ns() : 0;
+}
+
+void trace_span(trace_kind_t kind, uint64_t start, const char *detail) {
+    if (!tracer.enabled) {
+        return;
+    }
+    trace_buffer_t *buffer = thread_buffer();
+    if (buffer) {
+        append_event(buffer, kind, start, monotonic_ns(), detail);
+    }
+}
+
+void trace_lock_acquired(void) {
+    if (!tracer.enabled) {
+        return;
+    }
+    trace_buffer_t *buffer = thread_buffer();
+    if (!buffer) {
+        return;
+    }
+    // Growing only at exactly full keeps every slot below the capacity
+    // recorded, even after a failed realloc.
+    if (buffer->held_depth == buffer->held_capacity) {
+        size_t capacity = buffer->held_capacity ? buffer->held_capacity * 2
+                                                : TRACE_INITIAL_HELD;
+        uint64_t *grown =
+            (uint64_t *)realloc(buffer->held, capacity * sizeof(uint64_t));
+        if (grown) {
+            buffer->held = grown;
+            buffer->held_capacity = capacity;
+        }
+    }
+    if (buffer->held_depth < buffer->held_capacity) {
+        buffer->held[buffer->held_depth] = monotonic_ns();
+    }
+    buffer->held_depth++;
+}
+
+void trace_lock_released(const char *detail) {
+    if (!tracer.enabled) {
+        return;
+    }
+    trace_buffer_t *buffer = thread_buffer();
+    if (!buffer || buffer->held_depth == 0) {
+        return;
+    }
+    buffer->held_depth--;
+    if (buffer->held_depth < buffer->held_capacity) {
+        append_event(buffer, TRACE_LOCK_HOLD, buffer->held[buffer->held_depth],
+                     monotonic_ns(), detail);
+    }
+}
+
+void trace_thread_name(const char *fmt, ...) {
+    if (!tracer.enabled) {
+        return;
+    }
+    trace_buffer_t *buffer = thread_buffer();
+    if (!buffer) {
+        return;
+    }
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buffer->name, sizeof(buffer->name), fmt, args);
+    va_end(args);
+}